@@ -1,53 +1,151 @@
 #include "application.h"
 
 #include "entity/camera/camera.h"
+#include "entity/component/mesh/mesh_simplifier.h"
 #include "entity/light/directional_light.h"
 #include "entity/object3d/object3d.h"
 #include "input/input.h"
+#include "memory/allocation_counter.h"
 #include "parser/parser.h"
+#include "profiler/profiler.h"
 #include "time/time.h"
 #include "settings.h"
 
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
+#include <memory>
 #include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
 
 // REMEMBER: y-axis orientation is from top to bottom (y-)
 // REMEMBER: z-axis orientation is from back to front (z-)
 
 namespace engine {
 
+  // REMEMBER: the following functions are used exclusively inside this file
+
+  // The whole argument must be a number, so trailing characters are rejected
+  template <typename T>
+  static T ParseNumberArgument(const char* argument, const char* name) {
+    const char* end{argument + std::strlen(argument)};
+    T value{};
+
+    auto [ptr, ec] = std::from_chars(argument, end, value);
+    if (ec != std::errc{} || ptr != end) {
+      throw std::invalid_argument("ERROR: invalid " + std::string{name} + " " + std::string{argument});
+    }
+
+    return value;
+  }
+
   Application::Application() : 
     m_State{State::Ready},
     m_ScenePtr{nullptr},
     m_Screen{g_HorizontalRes, g_VerticalRes},
     m_GeometryProcessing{m_Screen}, 
-    m_Rasterization{m_Screen} 
+    m_Rasterization{m_Screen, g_RasterizationThreads},
+    m_Presenter{m_Screen, STDOUT_FILENO, g_DropStaleFrames ? PresentPolicy::DropStaleFrames : PresentPolicy::WaitForPresenter},
+    m_IsProfilerOverlayVisible{false},
+    m_FrameIndex{0},
+    m_SteadyStateAllocations{0}
   {}
 
   void Application::Start(int argc, char** argv) {
     m_State = State::Starting;
 
-    if (argc != 2) {
-      throw std::invalid_argument("ERROR: invalid number of arguments. Expected 2, got " + std::to_string(argc));
-    }
-
+    ParseArguments(argc, argv);
     SetupScene(argv);
+
+    Time::SetFrameRateLimit(g_FrameRateLimit);
+    PrepareProfilerOverlay();
   }
 
   void Application::Run() {
     m_State = State::Running;
 
+    if (m_HeadlessSettings.isEnabled) {
+      RunHeadless();
+      return;
+    }
+
     while (m_State == State::Running) {
       Time::UpdateDeltaTime();
 
-      HandleInput();
-      RenderScene();
+      std::size_t allocationCount{AllocationCounter::GetCount()};
+      std::chrono::duration<float> renderTime{0.0f};
+
+      {
+        ScopedTimer frameTimer{ProfilerStage::Frame};
+
+        HandleInput();
+
+        std::chrono::steady_clock::time_point renderStart{std::chrono::steady_clock::now()};
+        UpdateScene();
+        RenderScene();
+        renderTime = std::chrono::steady_clock::now() - renderStart;
+
+        UpdateProfilerOverlay();
+        m_Presenter.Submit(m_Screen);
+      }
+
+      Profiler::EndFrame();
+      CheckFrameAllocations(AllocationCounter::GetCount() - allocationCount);
+
+      UpdateResolution(renderTime.count());
+      Time::WaitForNextFrame();
     } 
   }
 
+  // Accepted syntax: engine <mesh.obj> [--headless <frame count> <delta time>]
+  void Application::ParseArguments(int argc, char** argv) {
+    if (argc != 2 && argc != 5) {
+      throw std::invalid_argument("ERROR: invalid number of arguments. Expected 2 or 5, got " + std::to_string(argc));
+    }
+
+    if (argc == 5) {
+      if (std::string{argv[2]} != "--headless") {
+        throw std::invalid_argument("ERROR: unknown option " + std::string{argv[2]});
+      }
+
+      long long frameCount{ParseNumberArgument<long long>(argv[3], "frame count")};
+      float deltaTime{ParseNumberArgument<float>(argv[4], "delta time")};
+
+      if (frameCount <= 0 || deltaTime < 0.0f) {
+        throw std::invalid_argument("ERROR: the frame count must be greater than 0 and the delta time cannot be negative");
+      }
+
+      m_HeadlessSettings.isEnabled = true;
+      m_HeadlessSettings.frameCount = static_cast<std::size_t>(frameCount);
+      m_HeadlessSettings.deltaTime = deltaTime;
+    }
+  }
+
   void Application::SetupScene(char** argv) {
+    Mesh mesh{Parser::LoadMeshFromFile(argv[1])};
+
+    if (g_UseMeshlets) {
+      mesh.BuildMeshlets();
+    }
+
+    if (g_UseVertexStreams) {
+      mesh.BuildVertexStreams();
+    }
+
+    auto sharedMesh{std::make_shared<const Mesh>(std::move(mesh))};
+    std::vector<MeshLod> lods{g_UseLods ? MeshSimplifier::BuildLodChain(sharedMesh) : std::vector<MeshLod>{MeshLod{sharedMesh, 0.0f}}};
+
     m_ScenePtr = std::make_unique<Scene>(
-      Object3D{Parser::LoadMeshFromFile(argv[1])},
+      std::vector<Object3D>{Object3D{std::move(lods)}},
       Camera{g_FovDeg, g_ZNear, g_ZFar},
       DirectionalLight{1.0f}
     );
@@ -56,6 +154,62 @@ namespace engine {
     m_ScenePtr->directionalLight.GetTransform().SetRotation(Vector3{0.0f, 180.0f, 0.0f}); // TO-DO: analyze the rotation's behavior
   }
 
+  // The scene is updated with the simulated delta time and rendered into the
+  // Screen buffer only. The wall-clock time of each frame is measured to 
+  // report the throughput, and the checksum of the final frame is printed
+  // to verify that the output did not change between runs
+  void Application::RunHeadless() {
+    using Clock = std::chrono::steady_clock;
+
+    Time::SetDeltaTime(m_HeadlessSettings.deltaTime);
+
+    std::chrono::duration<double> totalTime{0.0};
+    std::chrono::duration<double> minFrameTime{std::chrono::duration<double>::max()};
+    std::chrono::duration<double> maxFrameTime{0.0};
+
+    for (std::size_t i{0}; i < m_HeadlessSettings.frameCount; ++i) {
+      Clock::time_point frameStart{Clock::now()};
+      std::size_t allocationCount{AllocationCounter::GetCount()};
+
+      {
+        ScopedTimer frameTimer{ProfilerStage::Frame};
+
+        UpdateScene();
+        RenderScene();
+      }
+
+      std::chrono::duration<double> frameTime{Clock::now() - frameStart};
+      Profiler::EndFrame();
+      CheckFrameAllocations(AllocationCounter::GetCount() - allocationCount);
+
+      totalTime += frameTime;
+      minFrameTime = std::min(minFrameTime, frameTime);
+      maxFrameTime = std::max(maxFrameTime, frameTime);
+    }
+
+    const double frameCount{static_cast<double>(m_HeadlessSettings.frameCount)};
+
+    std::cout << "frames: " << m_HeadlessSettings.frameCount << '\n'
+      << "delta time (s): " << m_HeadlessSettings.deltaTime << '\n'
+      << "total time (ms): " << totalTime.count() * 1000.0 << '\n'
+      << "average frame time (ms): " << totalTime.count() * 1000.0 / frameCount << '\n'
+      << "min frame time (ms): " << minFrameTime.count() * 1000.0 << '\n'
+      << "max frame time (ms): " << maxFrameTime.count() * 1000.0 << '\n'
+      << "checksum: " << std::hex << m_Screen.GetChecksum() << std::dec << '\n';
+
+    if (AllocationCounter::IsEnabled()) {
+      std::cout << "steady state allocations: " << m_SteadyStateAllocations << '\n';
+    }
+
+    Profiler::GetReportLines(m_ProfilerLines);
+
+    for (const std::string& line : m_ProfilerLines) {
+      std::cout << line << '\n';
+    }
+
+    m_State = State::Shutting;
+  }
+
   void Application::HandleInput() {
     bool isAnyKeyBeenPressed{kbhit()};
 
@@ -65,19 +219,111 @@ namespace engine {
       if (key == 't') {
         m_State = State::Shutting;
       }
+      else if (key == 'p') {
+        m_IsProfilerOverlayVisible = !m_IsProfilerOverlayVisible;
+      }
+      else if (key == 'l') {
+        CycleFrameRateLimit();
+      }
     }
   }
 
+  void Application::UpdateScene() {
+    for (auto& object3D : m_ScenePtr->objects) {
+      object3D.GetTransform().ApplyRotation(
+        Vector3{0.0f, 90.0f * Time::GetDeltaTime(), 0.0f}
+      );
+    }
+  }
+
+  // The lines of the overlay are allocated before the first frame, so that
+  // showing it later does not allocate (the lines never exceed kLineCapacity)
+  void Application::PrepareProfilerOverlay() {
+    constexpr std::size_t kLineCapacity{128};
+
+    Profiler::GetReportLines(m_ProfilerLines);
+    m_OverlayLines.resize(m_ProfilerLines.size() + 1);
+
+    for (std::string& line : m_OverlayLines) {
+      line.reserve(kLineCapacity);
+    }
+
+    m_Screen.SetOverlayLines(m_OverlayLines);
+    m_Screen.ClearOverlayLines();
+  }
+
+  // Unlimited comes after the highest limit
+  void Application::CycleFrameRateLimit() {
+    constexpr std::array<float, 4> kFrameRateLimits{30.0f, 60.0f, 120.0f, 0.0f};
+
+    auto it{std::find(kFrameRateLimits.begin(), kFrameRateLimits.end(), Time::GetFrameRateLimit())};
+    std::size_t next{it == kFrameRateLimits.end() ? 0 : static_cast<std::size_t>(it - kFrameRateLimits.begin()) + 1};
+
+    Time::SetFrameRateLimit(kFrameRateLimits[next % kFrameRateLimits.size()]);
+  }
+
+  // The overlay shows the statistics of the previous frames, as the
+  // current one is not complete until it has been printed. The frame
+  // pacing is reported in an extra line below the stages
+  void Application::UpdateProfilerOverlay() {
+    if (m_IsProfilerOverlayVisible) {
+      Profiler::GetReportLines(m_ProfilerLines);
+
+      char buffer[128];   // Same size as the buffer of the profiler lines
+      if (Time::GetFrameRateLimit() > 0.0f) {
+        std::snprintf(buffer, sizeof(buffer), "frame rate limit: %.0f fps ('l' to change), missed deadlines: %zu, resolution: %dx%d", 
+          Time::GetFrameRateLimit(), Time::GetMissedDeadlineCount(), m_Screen.GetWidth(), m_Screen.GetHeight());
+      }
+      else {
+        std::snprintf(buffer, sizeof(buffer), "frame rate limit: unlimited ('l' to change), resolution: %dx%d", 
+          m_Screen.GetWidth(), m_Screen.GetHeight());
+      }
+
+      // The strings are assigned, so their capacity is reused
+      m_OverlayLines.resize(m_ProfilerLines.size() + 1);
+      std::copy(m_ProfilerLines.begin(), m_ProfilerLines.end(), m_OverlayLines.begin());
+      m_OverlayLines.back().assign(buffer);
+
+      m_Screen.SetOverlayLines(m_OverlayLines);
+    }
+    else {
+      m_Screen.ClearOverlayLines();
+    }
+  }
+
+  // During the first frames the buffers of the pipeline grow to the size
+  // required by the scene. After that, a frame must not allocate anything
+  // (checked only when the allocation counter is enabled)
+  void Application::CheckFrameAllocations(std::size_t allocationCount) {
+    constexpr std::size_t kWarmUpFrames{2};
+
+    if (AllocationCounter::IsEnabled() && m_FrameIndex >= kWarmUpFrames) {
+      m_SteadyStateAllocations += allocationCount;
+      assert(allocationCount == 0 && "a frame allocated memory after the warm-up");
+    }
+
+    ++m_FrameIndex;
+  }
+
+  // The budget is the frame time of the frame rate limit, so an unlimited
+  // frame rate is always rendered at full resolution
+  void Application::UpdateResolution(float renderTime) {
+    if (!g_UseDynamicResolution) {
+      return;
+    }
+
+    const float frameRateLimit{Time::GetFrameRateLimit()};
+
+    m_ResolutionController.SetFrameTimeBudget(frameRateLimit > 0.0f ? 1.0f / frameRateLimit : 0.0f);
+    m_ResolutionController.Update(renderTime, m_Screen);
+  }
+
+  // Renders the scene into the Screen buffer. Printing is left to the caller,
+  // so that headless runs can skip it
   void Application::RenderScene() {    
     m_Screen.ClearScreen();
 
-    m_ScenePtr->object3D.GetTransform().ApplyRotation(
-      Vector3{0.0f, 90.0f * Time::GetDeltaTime(), 0.0f}
-    );
-
     m_Rasterization.RasterizeMesh(m_GeometryProcessing.GetProcessedMesh(*m_ScenePtr));
-            
-    m_Screen.PrintScreen();
   }
   
 }
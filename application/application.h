@@ -3,11 +3,16 @@
 
 #include "geometry/primitive.h"
 #include "geometry_processing/geometry_processing.h"
+#include "presenter/presenter.h"
 #include "rasterization/rasterization.h"
+#include "resolution_controller/resolution_controller.h"
 #include "scene/scene.h"
 #include "screen/screen.h"
 
+#include <cstddef>
 #include <memory>
+#include <string>
+#include <vector>
 
 // This script defines the core of the engine, that is, what
 // handles the whole rendering process, from the elaboration
@@ -21,6 +26,15 @@ namespace engine {
     Running,
     Shutting
   };
+
+  // Settings of a headless run: a fixed number of frames is rendered
+  // with a fixed simulated delta time and nothing is printed, so that
+  // two runs on the same mesh always produce the same final frame
+  struct HeadlessSettings {
+    bool isEnabled{false};
+    std::size_t frameCount{0};
+    float deltaTime{0.0f};
+  };
         
   class Application {
   public:
@@ -32,13 +46,29 @@ namespace engine {
   private:
     State m_State;
     std::unique_ptr<Scene> m_ScenePtr;
+    Screen m_Screen;
     GeometryProcessing m_GeometryProcessing;
     Rasterization m_Rasterization;
-    Screen m_Screen;
+    Presenter m_Presenter;
+    ResolutionController m_ResolutionController;
+    HeadlessSettings m_HeadlessSettings;
+    bool m_IsProfilerOverlayVisible;
+    std::vector<std::string> m_ProfilerLines;   // Reused by the overlay
+    std::vector<std::string> m_OverlayLines;    // Profiler lines plus the frame pacing
+    std::size_t m_FrameIndex;
+    std::size_t m_SteadyStateAllocations;       // Allocations made after the warm-up frames
 
+    void ParseArguments(int argc, char** argv);
     void SetupScene(char** argv);
+    void RunHeadless();             // Renders a fixed number of frames and reports the timings
     void HandleInput();             // Handles the input
+    void UpdateScene();             // Applies the per-frame transformations
     void RenderScene();             // Handles the rendering pipeline
+    void PrepareProfilerOverlay();
+    void CycleFrameRateLimit();
+    void UpdateProfilerOverlay();
+    void CheckFrameAllocations(std::size_t allocationCount);
+    void UpdateResolution(float renderTime);
   };
   
 }
@@ -0,0 +1,361 @@
+#include "entity/camera/camera.h"
+#include "entity/component/mesh/mesh_optimizer.h"
+#include "entity/component/mesh/mesh_simplifier.h"
+#include "entity/light/directional_light.h"
+#include "entity/object3d/object3d.h"
+#include "geometry_processing/geometry_processing.h"
+#include "parser/mesh_cache.h"
+#include "parser/parser.h"
+#include "presenter/presenter.h"
+#include "rasterization/rasterization.h"
+#include "scene/scene.h"
+#include "screen/screen.h"
+#include "settings.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+// This script times every stage of the rendering pipeline separately on
+// the meshes shipped in the assets folder, and prints the results as JSON.
+// Each stage receives the output of the previous one, prepared outside of
+// the timed region, so the numbers do not include unrelated work
+//
+// Usage: engine_bench [assets directory]
+
+namespace engine {
+
+  struct BenchResult {
+    std::string mesh;
+    std::string stage;
+    std::size_t iterations;
+    double meanMs, medianMs, minMs, maxMs;
+    std::optional<double> meanOutputBytes;  // Terminal output stages only
+    std::optional<VertexCacheStats> vertexCacheStats;   // Vertex cache optimization only
+  };
+
+  class Benchmark {
+  public:
+    explicit Benchmark(const std::string& assetsDir) : m_AssetsDir{assetsDir} {}
+
+    void RunMesh(const std::string& meshName);
+    void RunScene(const std::string& meshName, std::size_t gridSize);
+    void PrintJson(std::ostream& os) const;
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr std::size_t k_MinIterations{10};
+    static constexpr std::size_t k_MaxIterations{10000};
+    static constexpr double k_MinTotalSeconds{0.25};
+
+    std::string m_AssetsDir;
+    std::vector<BenchResult> m_Results;
+
+    // Runs setup() untimed and body() timed until both the minimum number of 
+    // iterations and the minimum total time are reached
+    void Measure(const std::string& meshName, const std::string& stage,
+      const std::function<void()>& setup, const std::function<void()>& body);
+  };
+
+  void Benchmark::Measure(const std::string& meshName, const std::string& stage,
+    const std::function<void()>& setup, const std::function<void()>& body) 
+  {
+    std::vector<double> samples;
+    double totalSeconds{0.0};
+
+    while (samples.size() < k_MaxIterations && 
+      (samples.size() < k_MinIterations || totalSeconds < k_MinTotalSeconds)) 
+    {
+      setup();
+
+      Clock::time_point start{Clock::now()};
+      body();
+      std::chrono::duration<double> elapsed{Clock::now() - start};
+
+      samples.push_back(elapsed.count() * 1000.0);
+      totalSeconds += elapsed.count();
+    }
+
+    std::sort(samples.begin(), samples.end());
+
+    BenchResult result{};
+    result.mesh = meshName;
+    result.stage = stage;
+    result.iterations = samples.size();
+    result.meanMs = totalSeconds * 1000.0 / static_cast<double>(samples.size());
+    result.medianMs = samples[samples.size() / 2];
+    result.minMs = samples.front();
+    result.maxMs = samples.back();
+
+    m_Results.push_back(result);
+  }
+
+  void Benchmark::RunMesh(const std::string& meshName) {
+    const std::string filePath{m_AssetsDir + "/" + meshName + ".obj"};
+    const auto noSetup = []() {};
+
+    Measure(meshName, "Parser::ParseObjFile", noSetup, [&]() {
+      Mesh mesh{Parser::ParseObjFile(filePath)};
+    });
+
+    const Mesh parsed{Parser::ParseObjFile(filePath)};
+    Mesh reordered{parsed};
+    VertexCacheStats vertexCacheStats{};
+
+    Measure(meshName, "MeshOptimizer::OptimizeVertexCache", [&]() { reordered = parsed; }, [&]() {
+      vertexCacheStats = MeshOptimizer::OptimizeVertexCache(reordered);
+    });
+
+    m_Results.back().vertexCacheStats = vertexCacheStats;
+
+    // The cache is written once outside of the timed region
+    if (MeshCache::Store(filePath, Parser::ParseObjFile(filePath))) {
+      Measure(meshName, "MeshCache::Load", noSetup, [&]() {
+        std::optional<Mesh> mesh{MeshCache::Load(filePath)};
+      });
+    }
+
+    // Same scene as the one built by Application::SetupScene()
+    Screen screen{g_HorizontalRes, g_VerticalRes};
+    GeometryProcessing geometryProcessing{screen};
+    Rasterization rasterization{screen};
+
+    Mesh mesh{Parser::LoadMeshFromFile(filePath)};
+
+    if (g_UseMeshlets) {
+      mesh.BuildMeshlets();
+    }
+
+    if (g_UseVertexStreams) {
+      mesh.BuildVertexStreams();
+    }
+
+    Scene scene{
+      std::vector<Object3D>{Object3D{std::make_shared<const Mesh>(mesh)}},
+      Camera{g_FovDeg, g_ZNear, g_ZFar},
+      DirectionalLight{1.0f}
+    };
+
+    Object3D& object3D{scene.objects[0]};
+
+    scene.camera.GetTransform().SetPosition(Vector3{0.0f, -2.0f, -6.0f});
+    scene.directionalLight.GetTransform().SetRotation(Vector3{0.0f, 180.0f, 0.0f});
+    object3D.GetTransform().SetRotation(Vector3{0.0f, 30.0f, 0.0f});
+
+    geometryProcessing.CalculateViewMatrix(scene.camera);
+    geometryProcessing.CalculateProjectionMatrix(scene.camera);
+
+    const Mesh& objectMesh{object3D.GetMesh()};
+    const Transform& transform{object3D.GetTransform()};
+    const Matrix4x4 vertexMat{geometryProcessing.CalculateVertexMatrix(transform)};
+    const bool useStreams{!objectMesh.vertexStreams.IsEmpty()};
+
+    // Output of each stage, used as the input of the next one
+    Mesh culled{{}, IndexBuffer{}};
+    geometryProcessing.HandleBackfaceCulling(objectMesh, transform, scene.camera, culled, 0);
+
+    Mesh work{culled};
+
+    Measure(meshName, "GeometryProcessing::HandleBackfaceCulling", 
+      [&]() { work.indexBuffer.Clear(); work.triNormals.clear(); }, 
+      [&]() { geometryProcessing.HandleBackfaceCulling(objectMesh, transform, scene.camera, work, 0); }
+    );
+
+    Mesh shaded{culled};
+    geometryProcessing.HandleFlatShading(shaded, scene.directionalLight);
+
+    Measure(meshName, "GeometryProcessing::HandleFlatShading", 
+      [&]() { work = culled; }, 
+      [&]() { geometryProcessing.HandleFlatShading(work, scene.directionalLight); }
+    );
+
+    Mesh mapped{shaded};
+    geometryProcessing.HandleVertexProcessing(objectMesh, vertexMat, mapped, 0, useStreams);
+
+    Measure(meshName, "GeometryProcessing::HandleVertexProcessing", 
+      [&]() { work = shaded; }, 
+      [&]() { geometryProcessing.HandleVertexProcessing(objectMesh, vertexMat, work, 0, useStreams); }
+    );
+
+    Measure(meshName, "GeometryProcessing::GetProcessedMesh", noSetup, [&]() {
+      geometryProcessing.GetProcessedMesh(scene);
+    });
+
+    // Every span kernel supported by the CPU is timed
+    const SpanKernelType bestType{PixelKernel::GetBestSupportedType()};
+
+    for (SpanKernelType type : {SpanKernelType::Scalar, SpanKernelType::Sse41, SpanKernelType::Avx2}) {
+      if (static_cast<int>(type) > static_cast<int>(bestType)) {
+        continue;
+      }
+
+      rasterization.SetSpanKernelType(type);
+
+      Measure(meshName, std::string{"Rasterization::RasterizeMesh ("} + PixelKernel::GetTypeName(type) + ")", 
+        [&]() { screen.ClearScreen(); }, 
+        [&]() { rasterization.RasterizeMesh(mapped); }
+      );
+    }
+
+    rasterization.SetSpanKernelType(bestType);
+
+    // The output is written to /dev/null, so that the timings include the
+    // system calls without flooding the terminal and the JSON output
+    const int nullFd{open("/dev/null", O_WRONLY)};
+    if (nullFd < 0) {
+      return;
+    }
+
+    {
+      Presenter presenter{screen, nullFd, PresentPolicy::WaitForPresenter};
+
+      auto measureOutput = [&](const std::string& stage, const std::function<void()>& setup) {
+        const std::uint64_t totalBytes{presenter.GetTotalBytes()};
+
+        Measure(meshName, stage, setup, [&]() {
+          presenter.Submit(screen);
+          presenter.WaitUntilIdle();
+        });
+
+        BenchResult& result{m_Results.back()};
+        result.meanOutputBytes = static_cast<double>(presenter.GetTotalBytes() - totalBytes) / static_cast<double>(result.iterations);
+      };
+
+      measureOutput("Presenter (full redraw)", [&]() { presenter.InvalidatePresentedFrame(); });
+
+      // Consecutive frames of the mesh rotating as in the application at 60 FPS
+      measureOutput("Presenter (differential)", [&]() {
+        object3D.GetTransform().ApplyRotation(Vector3{0.0f, 90.0f / 60.0f, 0.0f});
+        screen.ClearScreen();
+        rasterization.RasterizeMesh(geometryProcessing.GetProcessedMesh(scene));
+      });
+    }
+
+    close(nullFd);
+  }
+
+  // A gridSize x gridSize grid of copies of the mesh around the camera, most
+  // of which are outside of the frustum
+  void Benchmark::RunScene(const std::string& meshName, std::size_t gridSize) {
+    Screen screen{g_HorizontalRes, g_VerticalRes};
+    GeometryProcessing geometryProcessing{screen};
+
+    Mesh mesh{Parser::LoadMeshFromFile(m_AssetsDir + "/" + meshName + ".obj")};
+
+    if (g_UseMeshlets) {
+      mesh.BuildMeshlets();
+    }
+
+    if (g_UseVertexStreams) {
+      mesh.BuildVertexStreams();
+    }
+
+    // Every object is an instance of the same mesh (and of its levels of detail)
+    const auto sharedMesh{std::make_shared<const Mesh>(std::move(mesh))};
+    const std::vector<MeshLod> lods{g_UseLods ? MeshSimplifier::BuildLodChain(sharedMesh) : std::vector<MeshLod>{MeshLod{sharedMesh, 0.0f}}};
+
+    constexpr float kSpacing{4.0f};
+    const float gridOffset{0.5f * kSpacing * static_cast<float>(gridSize - 1)};
+
+    std::vector<Object3D> objects;
+    objects.reserve(gridSize * gridSize);
+
+    for (std::size_t row{0}; row < gridSize; ++row) {
+      for (std::size_t col{0}; col < gridSize; ++col) {
+        Object3D object3D{lods};
+        object3D.GetTransform().SetPosition(Vector3{
+          kSpacing * static_cast<float>(col) - gridOffset, 0.0f, kSpacing * static_cast<float>(row) - gridOffset
+        });
+
+        objects.push_back(std::move(object3D));
+      }
+    }
+
+    Scene scene{std::move(objects), Camera{g_FovDeg, g_ZNear, g_ZFar}, DirectionalLight{1.0f}};
+    scene.camera.GetTransform().SetPosition(Vector3{0.0f, -2.0f, 0.0f});
+
+    const std::string sceneName{meshName + " (" + std::to_string(gridSize) + "x" + std::to_string(gridSize) + " grid)"};
+
+    geometryProcessing.CalculateViewMatrix(scene.camera);
+    geometryProcessing.CalculateProjectionMatrix(scene.camera);
+
+    std::vector<std::size_t> visibleObjects;
+
+    Measure(sceneName, "GeometryProcessing::HandleFrustumCulling", [](){}, [&]() {
+      geometryProcessing.HandleFrustumCulling(scene, visibleObjects);
+    });
+
+    Measure(sceneName, "GeometryProcessing::GetProcessedMesh", [](){}, [&]() {
+      geometryProcessing.GetProcessedMesh(scene);
+    });
+
+    // The rows of objects hide each other, so most of the triangles are occluded
+    Rasterization rasterization{screen};
+    const Mesh& processedMesh{geometryProcessing.GetProcessedMesh(scene)};
+
+    Measure(sceneName, "Rasterization::RasterizeMesh", [&]() { screen.ClearScreen(); }, [&]() {
+      rasterization.RasterizeMesh(processedMesh);
+    });
+  }
+
+  void Benchmark::PrintJson(std::ostream& os) const {
+    os << "{\n  \"resolution\": [" << g_HorizontalRes << ", " << g_VerticalRes << "],\n"
+      << "  \"results\": [\n";
+
+    for (std::size_t i{0}; i < m_Results.size(); ++i) {
+      const BenchResult& r{m_Results[i]};
+
+      os << "    {\"mesh\": \"" << r.mesh << "\", \"stage\": \"" << r.stage 
+        << "\", \"iterations\": " << r.iterations
+        << ", \"mean_ms\": " << r.meanMs << ", \"median_ms\": " << r.medianMs
+        << ", \"min_ms\": " << r.minMs << ", \"max_ms\": " << r.maxMs;
+
+      if (r.meanOutputBytes) {
+        os << ", \"mean_output_bytes\": " << *r.meanOutputBytes;
+      }
+
+      if (r.vertexCacheStats) {
+        os << ", \"acmr_before\": " << r.vertexCacheStats->acmrBefore << ", \"acmr_after\": " << r.vertexCacheStats->acmrAfter;
+      }
+
+      os << "}" << (i + 1 < m_Results.size() ? ",\n" : "\n");
+    }
+
+    os << "  ]\n}\n";
+  }
+
+}
+
+int main(int argc, char** argv) {
+  try {
+    engine::Benchmark benchmark{argc > 1 ? argv[1] : ENGINE_ASSETS_DIR};
+
+    for (const char* meshName : {"Cube", "Monkey", "Teapot"}) {
+      benchmark.RunMesh(meshName);
+    }
+
+    benchmark.RunScene("Monkey", 20);
+    benchmark.RunScene("Cube", 100);
+
+    benchmark.PrintJson(std::cout);
+
+    return EXIT_SUCCESS;
+  }
+  catch(const std::exception& e) {
+    std::cerr << e.what() << '\n';
+
+    return EXIT_FAILURE;
+  }
+}
@@ -1,10 +1,314 @@
 #include "mesh.h"
 
+#include "math/math.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+#include <utility>
+
 namespace engine {
+  // REMEMBER: the following constants and functions are used exclusively inside this file
+
+  constexpr std::size_t k_MinMeshletTriCount{64};
+  constexpr std::size_t k_MaxMeshletTriCount{128};
+
+  // Once a meshlet has k_MinMeshletTriCount triangles, it stops growing when
+  // the best candidate deviates more than this (cosine) from its axis
+  constexpr float k_MinMeshletNormalDot{0.9f};
+
+  // Weight of the distance from the meshlet (relative to the radius of the
+  // mesh) against the normal, so that the meshlets stay compact
+  constexpr float k_MeshletCompactness{4.0f};
+
+  struct PositionKeyHash {
+    std::size_t operator()(const std::array<std::uint32_t, 3>& key) const {
+      std::size_t hash{key[0]};
+      hash = hash * 1000003u ^ key[1];
+      hash = hash * 1000003u ^ key[2];
+      return hash;
+    }
+  };
+
+  // The vertices are split by normal, so the neighbors of a triangle are
+  // found through the positions of its vertices. Returns the position id of
+  // each vertex
+  static std::vector<std::size_t> WeldPositions(const std::vector<Vertex>& vertexBuffer, std::size_t& positionCount) {
+    std::unordered_map<std::array<std::uint32_t, 3>, std::size_t, PositionKeyHash> positionIds;
+    std::vector<std::size_t> vertexIds(vertexBuffer.size());
+
+    for (std::size_t i{0}; i < vertexBuffer.size(); ++i) {
+      const Vector3& p{vertexBuffer[i].position};
+
+      std::array<std::uint32_t, 3> key;
+      std::memcpy(&key[0], &p.x, sizeof(float));
+      std::memcpy(&key[1], &p.y, sizeof(float));
+      std::memcpy(&key[2], &p.z, sizeof(float));
+
+      vertexIds[i] = positionIds.try_emplace(key, positionIds.size()).first->second;
+    }
+
+    positionCount = positionIds.size();
+
+    return vertexIds;
+  }
+
+  // The triangles with a null normal (degenerate) never face the camera, so
+  // they do not widen the cone
+  static Meshlet CalculateMeshletBounds(
+    const Mesh& mesh, const std::vector<Vector3>& unitNormals, std::size_t triOffset, std::size_t triCount
+  ) {
+    Meshlet meshlet{triOffset, triCount, BoundingSphere{}, Vector3{}, 1.0f};
+
+    const Vector3& firstPosition{mesh.vertexBuffer[mesh.indexBuffer.GetTri(triOffset)[0]].position};
+    Aabb aabb{firstPosition, firstPosition};
+    Vector3 normalSum;
+
+    for (std::size_t i{triOffset}; i < triOffset + triCount; ++i) {
+      for (std::size_t v : mesh.indexBuffer.GetTri(i)) {
+        aabb = Aabb::GetUnion(aabb, Aabb{mesh.vertexBuffer[v].position, mesh.vertexBuffer[v].position});
+      }
+
+      normalSum += unitNormals[i];
+    }
+
+    meshlet.boundingSphere.center = aabb.GetCenter();
+
+    for (std::size_t i{triOffset}; i < triOffset + triCount; ++i) {
+      for (std::size_t v : mesh.indexBuffer.GetTri(i)) {
+        meshlet.boundingSphere.radius = std::max(
+          meshlet.boundingSphere.radius, (mesh.vertexBuffer[v].position - meshlet.boundingSphere.center).GetModule()
+        );
+      }
+    }
+
+    if (normalSum.GetModule() == 0.0f) {
+      return meshlet;
+    }
+
+    meshlet.coneAxis = normalSum.GetNormalized();
+
+    float minDot{1.0f};
+    for (std::size_t i{triOffset}; i < triOffset + triCount; ++i) {
+      if (unitNormals[i].GetModule() > 0.0f) {
+        minDot = std::min(minDot, Math::DotProduct(meshlet.coneAxis, unitNormals[i]));
+      }
+    }
+
+    // A cone of 90 degrees or more always has a normal facing the camera
+    if (minDot > 0.0f) {
+      meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+    }
+
+    return meshlet;
+  }
   
-  Mesh::Mesh(const std::vector<Vertex>& vertexBuffer, const std::vector<std::array<std::size_t, 3>>& indexBuffer) : 
+  Mesh::Mesh(std::vector<Vertex> vertexBuffer, const std::vector<std::array<std::size_t, 3>>& indexBuffer) : 
+    vertexBuffer{std::move(vertexBuffer)}, 
+    indexBuffer{indexBuffer, this->vertexBuffer.size()} 
+  {
+    CalculateTriPlanes();
+    CalculateBounds();
+  }
+
+  Mesh::Mesh(std::vector<Vertex> vertexBuffer, IndexBuffer indexBuffer) : 
     vertexBuffer{std::move(vertexBuffer)}, 
     indexBuffer{std::move(indexBuffer)} 
-  {}
+  {
+    CalculateTriPlanes();
+    CalculateBounds();
+  }
+
+  Vector3 Mesh::GetPosition(std::size_t vertexIndex) const {
+    if (vertexStreams.IsEmpty()) {
+      return vertexBuffer[vertexIndex].position;
+    }
+
+    return vertexStreams.GetPosition(vertexIndex);
+  }
+
+  void Mesh::BuildVertexStreams() {
+    vertexStreams.CopyFrom(vertexBuffer);
+  }
+
+  // The meshlets are grown greedily: starting from the first triangle not
+  // assigned yet, the neighbor whose normal is the closest to the average
+  // normal of the meshlet is added, until the meshlet is full or no
+  // neighbor is close enough. The triangles keep their relative order inside
+  // each meshlet, so the order given by the vertex cache optimization is
+  // mostly preserved
+  void Mesh::BuildMeshlets() {
+    const std::vector<std::array<std::size_t, 3>> tris{indexBuffer.GetWideTris()};
+    const std::size_t triCount{tris.size()};
+
+    std::size_t positionCount{0};
+    const std::vector<std::size_t> positionIds{WeldPositions(vertexBuffer, positionCount)};
+
+    // Triangles around each position, stored in a single array
+    std::vector<std::size_t> adjacencyOffsets(positionCount + 1, 0);
+    for (const auto& triIndices : tris) {
+      for (std::size_t v : triIndices) {
+        ++adjacencyOffsets[positionIds[v] + 1];
+      }
+    }
+
+    for (std::size_t p{0}; p < positionCount; ++p) {
+      adjacencyOffsets[p + 1] += adjacencyOffsets[p];
+    }
+
+    std::vector<std::size_t> adjacency(adjacencyOffsets[positionCount]);
+    std::vector<std::size_t> fillCounts(positionCount, 0);
+    for (std::size_t t{0}; t < triCount; ++t) {
+      for (std::size_t v : tris[t]) {
+        const std::size_t p{positionIds[v]};
+        adjacency[adjacencyOffsets[p] + fillCounts[p]++] = t;
+      }
+    }
+
+    std::vector<Vector3> unitNormals(triCount);
+    for (std::size_t t{0}; t < triCount; ++t) {
+      if (triNormals[t].GetModule() > 0.0f) {
+        unitNormals[t] = triNormals[t].GetNormalized();
+      }
+    }
+
+    std::vector<Vector3> centroids(triCount);
+    for (std::size_t t{0}; t < triCount; ++t) {
+      centroids[t] = (vertexBuffer[tris[t][0]].position + vertexBuffer[tris[t][1]].position + vertexBuffer[tris[t][2]].position) / 3.0f;
+    }
+
+    const float distanceWeight{boundingSphere.radius > 0.0f ? k_MeshletCompactness / boundingSphere.radius : 0.0f};
+
+    std::vector<bool> isTriAssigned(triCount, false);
+    std::vector<bool> isCandidate(triCount, false);
+    std::vector<std::size_t> candidates;
+    std::vector<std::size_t> meshletTris;
+    std::vector<std::size_t> meshletSizes;
+    std::vector<std::array<std::size_t, 3>> newTris;
+    newTris.reserve(triCount);
+
+    for (std::size_t seed{0}; seed < triCount; ++seed) {
+      if (isTriAssigned[seed]) {
+        continue;
+      }
+
+      meshletTris.clear();
+      candidates.clear();
+
+      Vector3 normalSum;
+      Vector3 centroidSum;
+      std::size_t next{seed};
+
+      while (true) {
+        isTriAssigned[next] = true;
+        meshletTris.push_back(next);
+        normalSum += unitNormals[next];
+        centroidSum += centroids[next];
+
+        for (std::size_t v : tris[next]) {
+          const std::size_t p{positionIds[v]};
+
+          for (std::size_t i{adjacencyOffsets[p]}; i < adjacencyOffsets[p + 1]; ++i) {
+            const std::size_t t{adjacency[i]};
+
+            if (!isTriAssigned[t] && !isCandidate[t]) {
+              isCandidate[t] = true;
+              candidates.push_back(t);
+            }
+          }
+        }
+
+        if (meshletTris.size() == k_MaxMeshletTriCount) {
+          break;
+        }
+
+        // The candidates already assigned are removed while looking for the best one
+        const Vector3 axis{normalSum.GetModule() > 0.0f ? normalSum.GetNormalized() : normalSum};
+        const Vector3 centroid{centroidSum / static_cast<float>(meshletTris.size())};
+        std::size_t best{triCount};
+        float bestDot{-2.0f};
+        float bestScore{std::numeric_limits<float>::lowest()};
+
+        candidates.erase(
+          std::remove_if(candidates.begin(), candidates.end(), [&](std::size_t t) { return isTriAssigned[t]; }), candidates.end()
+        );
+
+        for (std::size_t t : candidates) {
+          const float dot{Math::DotProduct(axis, unitNormals[t])};
+          const float score{dot - distanceWeight * (centroids[t] - centroid).GetModule()};
+
+          if (score > bestScore) {
+            best = t;
+            bestDot = dot;
+            bestScore = score;
+          }
+        }
+
+        if (best == triCount || (meshletTris.size() >= k_MinMeshletTriCount && bestDot < k_MinMeshletNormalDot)) {
+          break;
+        }
+
+        next = best;
+      }
+
+      for (std::size_t t : candidates) {
+        isCandidate[t] = false;
+      }
+
+      std::sort(meshletTris.begin(), meshletTris.end());
+
+      for (std::size_t t : meshletTris) {
+        newTris.push_back(tris[t]);
+      }
+
+      meshletSizes.push_back(meshletTris.size());
+    }
+
+    indexBuffer = IndexBuffer{newTris, vertexBuffer.size()};
+    CalculateTriPlanes();
+
+    for (std::size_t t{0}; t < triCount; ++t) {
+      unitNormals[t] = triNormals[t].GetModule() > 0.0f ? triNormals[t].GetNormalized() : Vector3{};
+    }
+
+    meshlets.clear();
+    meshlets.reserve(meshletSizes.size());
+
+    std::size_t triOffset{0};
+    for (std::size_t size : meshletSizes) {
+      meshlets.push_back(CalculateMeshletBounds(*this, unitNormals, triOffset, size));
+      triOffset += size;
+    }
+  }
+
+  // Calculate the normal vector of the triangles of the mesh taking advantage 
+  // of the clock-wise order of the vertices. The vertices are first translated
+  // so that adjacent lines originate at (0, 0, 0), then their cross product
+  // is calculated
+  void Mesh::CalculateTriPlanes() {
+    indexBuffer.Visit([this](const auto& tris) {
+      triNormals.resize(tris.size());
+      triOffsets.resize(tris.size());
+
+      for (std::size_t i{0}; i < tris.size(); ++i) {
+        const auto& triIndices{tris[i]};
+        const Vector3& p0{vertexBuffer[triIndices[0]].position};
+
+        triNormals[i] = Math::CrossProduct(
+          vertexBuffer[triIndices[1]].position - p0, 
+          vertexBuffer[triIndices[2]].position - p0
+        );
+        triOffsets[i] = Math::DotProduct(triNormals[i], p0);
+      }
+    });
+  }
+
+  void Mesh::CalculateBounds() {
+    aabb = Aabb::FromVertices(vertexBuffer);
+    boundingSphere = BoundingSphere::FromVertices(vertexBuffer, aabb);
+  }
   
 }
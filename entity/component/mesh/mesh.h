@@ -1,25 +1,69 @@
 #ifndef MESH_H
 #define MESH_H
 
+#include "geometry/bounding_volume.h"
+#include "geometry/index_buffer.h"
 #include "geometry/primitive.h"
+#include "geometry/vertex_streams.h"
 
 #include <array>
+#include <memory>
 #include <vector>
 
 // Meshes are made of vertices, and a triangle contains 3 vertices.
-// All the vertices are inside the vertexBuffer, and the triangles
-// are reconstructed from the indexBuffer
+// All the vertices are inside the vertexBuffer, and the triangles are
+// reconstructed from the indexBuffer (16-bit or 32-bit, see IndexBuffer).
+// The planes of the triangles and the bounding volumes are calculated once,
+// in object space, when the mesh is created.
+// Optionally, the positions are also stored in the structure-of-arrays
+// layout (vertexStreams). When present, the streams are the ones read by
+// the vertex processing, which then writes the transformed positions only
+// into the streams of the processed mesh (GetPosition() reads whichever
+// layout is filled).
+// Optionally, the triangles are also grouped into meshlets: clusters of
+// neighboring triangles facing similar directions, stored contiguously in
+// the indexBuffer, whose bounds let the culling reject them as a whole
 
 namespace engine {
 
+  // Cluster of triangles of a mesh (see Mesh::BuildMeshlets())
+  struct Meshlet {
+    std::size_t triOffset;        // First triangle in the indexBuffer
+    std::size_t triCount;
+    BoundingSphere boundingSphere;  // Object space
+    Vector3 coneAxis;             // Normalized average of the normals of the triangles
+    float coneCutoff;             // Sine of the widest angle between the axis and a normal (1 = the cone cannot be culled)
+  };
+
   class Mesh {
   public:
     std::vector<Vertex> vertexBuffer;                     // Vertices
-    std::vector<std::array<std::size_t, 3>> indexBuffer;  // Indices of the vertices of each triangle
-    std::vector<Vector3> triNormals;                      // Normals of each triangle
+    IndexBuffer indexBuffer;                              // Indices of the vertices of each triangle
+    std::vector<Vector3> triNormals;                      // Normals of each triangle (not normalized)
+    std::vector<float> triOffsets;                        // Dot product between each triangle's normal and its first vertex
     std::vector<float> triBrightness;                     // Brightness of each triangle
+    VertexStreams vertexStreams;                          // Optional SoA copy of the vertexBuffer
+    std::vector<Meshlet> meshlets;                        // Optional clusters of the triangles
+    Aabb aabb;                                            // Object space bounding box
+    BoundingSphere boundingSphere;                        // Object space bounding sphere
         
-    Mesh(const std::vector<Vertex>& vertexBuffer, const std::vector<std::array<std::size_t, 3>>& indexBuffer);
+    // The indices are stored with the smallest type that fits the vertex count
+    Mesh(std::vector<Vertex> vertexBuffer, const std::vector<std::array<std::size_t, 3>>& indexBuffer);
+    Mesh(std::vector<Vertex> vertexBuffer, IndexBuffer indexBuffer);
+
+    // Getter (reads from the streams when they are present)
+    Vector3 GetPosition(std::size_t vertexIndex) const;
+
+    void BuildVertexStreams();
+    void BuildMeshlets();         // Reorders the triangles (and recalculates their planes)
+    void CalculateTriPlanes();    // Fills triNormals and triOffsets (called by the constructor)
+    void CalculateBounds();       // Fills aabb and boundingSphere (called by the constructor)
+  };
+
+  // A level of detail of a mesh (see MeshSimplifier)
+  struct MeshLod {
+    std::shared_ptr<const Mesh> mesh;
+    float error;                  // Largest object space distance between its surface and the full-detail one
   };
   
 }
@@ -0,0 +1,207 @@
+#include "mesh_optimizer.h"
+
+#include <limits>
+#include <utility>
+
+namespace engine {
+  // REMEMBER: the following constants and functions are used exclusively inside this file
+
+  using TriIndices = std::array<std::size_t, 3>;
+
+  constexpr std::size_t k_NoVertex{std::numeric_limits<std::size_t>::max()};
+
+  // Returns the most recently used vertex that still has triangles left, then
+  // the first such vertex in index order (after the ones already scanned)
+  static std::size_t SkipDeadEnd(
+    std::vector<std::size_t>& deadEndStack, const std::vector<std::size_t>& liveTriCounts, std::size_t& cursor
+  ) {
+    while (!deadEndStack.empty()) {
+      const std::size_t v{deadEndStack.back()};
+      deadEndStack.pop_back();
+
+      if (liveTriCounts[v] > 0) {
+        return v;
+      }
+    }
+
+    for (; cursor < liveTriCounts.size(); ++cursor) {
+      if (liveTriCounts[cursor] > 0) {
+        return cursor;
+      }
+    }
+
+    return k_NoVertex;
+  }
+
+  // A candidate is better the older it is in the cache, as long as it will
+  // still be there once its remaining triangles are emitted (each of them
+  // can push at most 2 new vertices)
+  static std::size_t GetNextVertex(
+    const std::vector<std::size_t>& candidates, const std::vector<std::size_t>& liveTriCounts,
+    const std::vector<std::size_t>& cacheTimes, std::size_t time, 
+    std::vector<std::size_t>& deadEndStack, std::size_t& cursor
+  ) {
+    std::size_t bestVertex{k_NoVertex};
+    std::size_t bestPriority{0};
+
+    for (std::size_t v : candidates) {
+      if (liveTriCounts[v] == 0) {
+        continue;
+      }
+
+      std::size_t priority{0};
+      if (time - cacheTimes[v] + 2 * liveTriCounts[v] <= MeshOptimizer::k_CacheSize) {
+        priority = time - cacheTimes[v];
+      }
+
+      if (bestVertex == k_NoVertex || priority > bestPriority) {
+        bestVertex = v;
+        bestPriority = priority;
+      }
+    }
+
+    if (bestVertex == k_NoVertex) {
+      bestVertex = SkipDeadEnd(deadEndStack, liveTriCounts, cursor);
+    }
+
+    return bestVertex;
+  }
+
+  // The cache time of a vertex is the value of the miss counter when it was
+  // last loaded, so it is in the FIFO cache while fewer than k_CacheSize
+  // misses happened since then
+  float MeshOptimizer::GetAcmr(const std::vector<TriIndices>& indexBuffer, std::size_t vertexCount) {
+    if (indexBuffer.empty()) {
+      return 0.0f;
+    }
+
+    std::vector<std::size_t> cacheTimes(vertexCount, 0);
+    std::size_t missCount{0};
+
+    for (const auto& triIndices : indexBuffer) {
+      for (std::size_t v : triIndices) {
+        if (cacheTimes[v] == 0 || missCount - cacheTimes[v] >= k_CacheSize) {
+          ++missCount;
+          cacheTimes[v] = missCount;
+        }
+      }
+    }
+
+    return static_cast<float>(missCount) / static_cast<float>(indexBuffer.size());
+  }
+
+  VertexCacheStats MeshOptimizer::OptimizeVertexCache(Mesh& mesh) {
+    const std::size_t vertexCount{mesh.vertexBuffer.size()};
+    const std::vector<TriIndices> sourceTris{mesh.indexBuffer.GetWideTris()};
+    const std::size_t triCount{sourceTris.size()};
+
+    VertexCacheStats stats{};
+    stats.acmrBefore = GetAcmr(sourceTris, vertexCount);
+
+    std::vector<std::size_t> liveTriCounts(vertexCount, 0);
+    for (const auto& triIndices : sourceTris) {
+      for (std::size_t v : triIndices) {
+        ++liveTriCounts[v];
+      }
+    }
+
+    // Triangles around each vertex, stored in a single array
+    std::vector<std::size_t> adjacencyOffsets(vertexCount + 1, 0);
+    for (std::size_t v{0}; v < vertexCount; ++v) {
+      adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriCounts[v];
+    }
+
+    std::vector<std::size_t> adjacency(adjacencyOffsets[vertexCount]);
+    std::vector<std::size_t> fillCounts(vertexCount, 0);
+    for (std::size_t t{0}; t < triCount; ++t) {
+      for (std::size_t v : sourceTris[t]) {
+        adjacency[adjacencyOffsets[v] + fillCounts[v]++] = t;
+      }
+    }
+
+    // The time starts past the cache size, so no vertex is initially in it
+    std::vector<std::size_t> cacheTimes(vertexCount, 0);
+    std::size_t time{k_CacheSize + 1};
+
+    std::vector<bool> isTriEmitted(triCount, false);
+    std::vector<std::size_t> deadEndStack;
+    std::vector<std::size_t> candidates;
+    std::size_t cursor{0};
+
+    std::vector<TriIndices> indexBuffer;
+    indexBuffer.reserve(triCount);
+
+    std::size_t fanVertex{SkipDeadEnd(deadEndStack, liveTriCounts, cursor)};
+
+    while (fanVertex != k_NoVertex) {
+      candidates.clear();
+
+      for (std::size_t i{adjacencyOffsets[fanVertex]}; i < adjacencyOffsets[fanVertex + 1]; ++i) {
+        const std::size_t t{adjacency[i]};
+
+        if (isTriEmitted[t]) {
+          continue;
+        }
+
+        for (std::size_t v : sourceTris[t]) {
+          deadEndStack.push_back(v);
+          candidates.push_back(v);
+          --liveTriCounts[v];
+
+          if (time - cacheTimes[v] > k_CacheSize) {
+            cacheTimes[v] = time;
+            ++time;
+          }
+        }
+
+        isTriEmitted[t] = true;
+        indexBuffer.push_back(sourceTris[t]);
+      }
+
+      fanVertex = GetNextVertex(candidates, liveTriCounts, cacheTimes, time, deadEndStack, cursor);
+    }
+
+    // Renumbers the vertices in order of first use. The ones not used by any
+    // triangle are kept after the others
+    std::vector<std::size_t> newIndices(vertexCount, k_NoVertex);
+    std::size_t nextIndex{0};
+
+    for (auto& triIndices : indexBuffer) {
+      for (std::size_t& v : triIndices) {
+        if (newIndices[v] == k_NoVertex) {
+          newIndices[v] = nextIndex++;
+        }
+
+        v = newIndices[v];
+      }
+    }
+
+    for (std::size_t v{0}; v < vertexCount; ++v) {
+      if (newIndices[v] == k_NoVertex) {
+        newIndices[v] = nextIndex++;
+      }
+    }
+
+    std::vector<Vertex> vertexBuffer(vertexCount);
+    for (std::size_t v{0}; v < vertexCount; ++v) {
+      vertexBuffer[newIndices[v]] = mesh.vertexBuffer[v];
+    }
+
+    stats.acmrAfter = GetAcmr(indexBuffer, vertexCount);
+
+    mesh.vertexBuffer = std::move(vertexBuffer);
+    mesh.indexBuffer = IndexBuffer{indexBuffer, vertexCount};
+    mesh.CalculateTriPlanes();
+
+    if (!mesh.meshlets.empty()) {
+      mesh.BuildMeshlets();
+    }
+
+    if (!mesh.vertexStreams.IsEmpty()) {
+      mesh.BuildVertexStreams();
+    }
+
+    return stats;
+  }
+
+}
@@ -0,0 +1,42 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include "entity/component/mesh/mesh.h"
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+// Reorders the triangles of meshes so that consecutive triangles reuse the
+// same vertices (Tipsify, by Sander, Nehab and Barczak): the triangles are
+// emitted as fans around a vertex, and the next vertex is the one among the
+// last used ones that is still in a simulated FIFO cache of k_CacheSize
+// vertices and has triangles left. The vertices are then renumbered in the
+// order they are first used, so the per-triangle gathers of the pipeline
+// walk through the vertexBuffer almost sequentially instead of jumping
+// around it. The quality of an order is measured as its average cache miss
+// ratio (ACMR): the vertices missing the simulated cache per triangle
+
+namespace engine {
+
+  struct VertexCacheStats {
+    float acmrBefore;
+    float acmrAfter;
+  };
+
+  class MeshOptimizer {
+  public:
+    MeshOptimizer() = delete;
+
+    static constexpr std::size_t k_CacheSize{16};
+
+    static float GetAcmr(const std::vector<std::array<std::size_t, 3>>& indexBuffer, std::size_t vertexCount);
+
+    // The triangle planes (and the meshlets and the vertex streams, if
+    // present) are updated to the new order. The bounding volumes do not change
+    static VertexCacheStats OptimizeVertexCache(Mesh& mesh);
+  };
+
+}
+
+#endif
@@ -0,0 +1,520 @@
+#include "mesh_simplifier.h"
+
+#include "entity/component/mesh/mesh_optimizer.h"
+#include "settings.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+namespace engine {
+  // REMEMBER: the following structs and functions are used exclusively inside this file
+
+  using TriIndices = std::array<std::size_t, 3>;
+
+  constexpr double k_BorderWeight{4.0};         // Of the planes that keep the open borders in place
+  constexpr double k_MinDeterminant{1e-9};      // Below it the optimal point of a quadric is not reliable
+
+  // The simplification works in double precision, as the quadrics sum the
+  // squares of many small distances
+  struct Point {
+    double x, y, z;
+  };
+
+  static Point operator+(const Point& a, const Point& b) { return Point{a.x + b.x, a.y + b.y, a.z + b.z}; }
+
+  static Point operator-(const Point& a, const Point& b) { return Point{a.x - b.x, a.y - b.y, a.z - b.z}; }
+
+  static Point operator*(const Point& a, double val) { return Point{a.x * val, a.y * val, a.z * val}; }
+
+  static double Dot(const Point& a, const Point& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+  static Point Cross(const Point& a, const Point& b) {
+    return Point{a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+  }
+
+  static double Length(const Point& a) { return std::sqrt(Dot(a, a)); }
+
+  // Symmetric 4x4 matrix whose quadratic form gives the sum of the squared
+  // distances of a point from a set of planes
+  struct Quadric {
+    std::array<double, 10> q{};   // q00 q01 q02 q03 q11 q12 q13 q22 q23 q33
+
+    // The normal (a, b, c) must be normalized
+    void AddPlane(double a, double b, double c, double d, double weight) {
+      q[0] += weight * a * a; q[1] += weight * a * b; q[2] += weight * a * c; q[3] += weight * a * d;
+      q[4] += weight * b * b; q[5] += weight * b * c; q[6] += weight * b * d;
+      q[7] += weight * c * c; q[8] += weight * c * d;
+      q[9] += weight * d * d;
+    }
+
+    Quadric& operator+=(const Quadric& other) {
+      for (std::size_t i{0}; i < q.size(); ++i) {
+        q[i] += other.q[i];
+      }
+
+      return *this;
+    }
+
+    double Evaluate(const Point& p) const {
+      return q[0] * p.x * p.x + 2.0 * q[1] * p.x * p.y + 2.0 * q[2] * p.x * p.z + 2.0 * q[3] * p.x
+        + q[4] * p.y * p.y + 2.0 * q[5] * p.y * p.z + 2.0 * q[6] * p.y
+        + q[7] * p.z * p.z + 2.0 * q[8] * p.z
+        + q[9];
+    }
+
+    // Solves the linear system given by the gradient (Cramer's rule).
+    // Returns false when it is (nearly) singular, e.g. on flat regions
+    bool Minimize(Point& p) const {
+      const double det{
+        q[0] * (q[4] * q[7] - q[5] * q[5]) - q[1] * (q[1] * q[7] - q[5] * q[2]) + q[2] * (q[1] * q[5] - q[4] * q[2])
+      };
+
+      if (std::abs(det) < k_MinDeterminant) {
+        return false;
+      }
+
+      const double bx{-q[3]}, by{-q[6]}, bz{-q[8]};
+
+      p.x = (bx * (q[4] * q[7] - q[5] * q[5]) - q[1] * (by * q[7] - q[5] * bz) + q[2] * (by * q[5] - q[4] * bz)) / det;
+      p.y = (q[0] * (by * q[7] - q[5] * bz) - bx * (q[1] * q[7] - q[5] * q[2]) + q[2] * (q[1] * bz - by * q[2])) / det;
+      p.z = (q[0] * (q[4] * bz - by * q[5]) - q[1] * (q[1] * bz - by * q[2]) + bx * (q[1] * q[5] - q[4] * q[2])) / det;
+
+      return true;
+    }
+  };
+
+  struct Collapse {
+    double cost;
+    std::size_t v1, v2;               // v2 is merged into v1
+    std::size_t version1, version2;   // Versions of the vertices when the collapse was evaluated
+    Point position;
+
+    bool operator>(const Collapse& other) const { return cost > other.cost; }
+  };
+
+  struct PositionKeyHash {
+    std::size_t operator()(const std::array<std::uint32_t, 3>& key) const {
+      std::size_t hash{key[0]};
+      hash = hash * 1000003u ^ key[1];
+      hash = hash * 1000003u ^ key[2];
+      return hash;
+    }
+  };
+
+  // State of the simplification of one mesh. The triangles and the vertices
+  // removed by the collapses are only flagged, and each vertex keeps the
+  // list of the triangles around it
+  struct Simplifier {
+    std::vector<Point> positions;
+    std::vector<Quadric> quadrics;
+    std::vector<std::vector<std::size_t>> vertexTris;
+    std::vector<std::size_t> versions;    // Incremented when a vertex moves, to discard its old collapses
+    std::vector<bool> isVertexAlive;
+    std::vector<bool> isBorderVertex;
+    std::vector<TriIndices> tris;
+    std::vector<bool> isTriAlive;
+    std::size_t triCount{0};
+    double error{0.0};
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> collapses;
+    std::vector<std::size_t> neighbors1, neighbors2;
+
+    explicit Simplifier(const Mesh& mesh);
+
+    bool CollapseUntil(std::size_t targetTriCount);
+    Mesh Extract() const;
+
+    void PushCollapse(std::size_t v1, std::size_t v2);
+    bool IsCollapseValid(const Collapse& collapse);
+    void ApplyCollapse(const Collapse& collapse);
+    void GatherNeighbors(std::size_t v, std::vector<std::size_t>& neighbors) const;
+  };
+
+  Simplifier::Simplifier(const Mesh& mesh) {
+    // Welds the vertices by position
+    std::unordered_map<std::array<std::uint32_t, 3>, std::size_t, PositionKeyHash> positionIds;
+    std::vector<std::size_t> vertexIds(mesh.vertexBuffer.size());
+
+    for (std::size_t i{0}; i < mesh.vertexBuffer.size(); ++i) {
+      const Vector3& p{mesh.vertexBuffer[i].position};
+
+      std::array<std::uint32_t, 3> key;
+      std::memcpy(&key[0], &p.x, sizeof(float));
+      std::memcpy(&key[1], &p.y, sizeof(float));
+      std::memcpy(&key[2], &p.z, sizeof(float));
+
+      auto [it, isInserted]{positionIds.try_emplace(key, positions.size())};
+      if (isInserted) {
+        positions.push_back(Point{p.x, p.y, p.z});
+      }
+
+      vertexIds[i] = it->second;
+    }
+
+    const std::size_t vertexCount{positions.size()};
+
+    quadrics.resize(vertexCount);
+    vertexTris.resize(vertexCount);
+    versions.resize(vertexCount, 0);
+    isVertexAlive.resize(vertexCount, true);
+    isBorderVertex.resize(vertexCount, false);
+
+    for (const auto& triIndices : mesh.indexBuffer.GetWideTris()) {
+      TriIndices tri{vertexIds[triIndices[0]], vertexIds[triIndices[1]], vertexIds[triIndices[2]]};
+
+      if (tri[0] != tri[1] && tri[1] != tri[2] && tri[0] != tri[2]) {
+        tris.push_back(tri);
+      }
+    }
+
+    triCount = tris.size();
+    isTriAlive.resize(triCount, true);
+
+    // Edges as (smaller vertex, larger vertex, triangle)
+    std::vector<std::array<std::size_t, 3>> edges;
+    edges.reserve(3 * triCount);
+
+    for (std::size_t t{0}; t < triCount; ++t) {
+      const TriIndices& tri{tris[t]};
+      const Point normal{Cross(positions[tri[1]] - positions[tri[0]], positions[tri[2]] - positions[tri[0]])};
+      const double length{Length(normal)};
+
+      if (length > 0.0) {
+        const Point n{normal * (1.0 / length)};
+        const double d{-Dot(n, positions[tri[0]])};
+
+        for (std::size_t v : tri) {
+          quadrics[v].AddPlane(n.x, n.y, n.z, d, 1.0);
+        }
+      }
+
+      for (std::size_t k{0}; k < 3; ++k) {
+        vertexTris[tri[k]].push_back(t);
+
+        std::size_t a{tri[k]}, b{tri[(k + 1) % 3]};
+        edges.push_back({std::min(a, b), std::max(a, b), t});
+      }
+    }
+
+    std::sort(edges.begin(), edges.end());
+
+    for (std::size_t i{0}; i < edges.size();) {
+      std::size_t j{i + 1};
+      while (j < edges.size() && edges[j][0] == edges[i][0] && edges[j][1] == edges[i][1]) {
+        ++j;
+      }
+
+      const std::size_t a{edges[i][0]}, b{edges[i][1]};
+
+      // An edge of a single triangle is on an open border: the plane through
+      // it, perpendicular to the triangle, keeps it from moving inwards
+      if (j - i == 1) {
+        const TriIndices& tri{tris[edges[i][2]]};
+        const Point triNormal{Cross(positions[tri[1]] - positions[tri[0]], positions[tri[2]] - positions[tri[0]])};
+        const Point borderNormal{Cross(positions[b] - positions[a], triNormal)};
+        const double length{Length(borderNormal)};
+
+        if (length > 0.0) {
+          const Point n{borderNormal * (1.0 / length)};
+          const double d{-Dot(n, positions[a])};
+
+          quadrics[a].AddPlane(n.x, n.y, n.z, d, k_BorderWeight);
+          quadrics[b].AddPlane(n.x, n.y, n.z, d, k_BorderWeight);
+        }
+
+        isBorderVertex[a] = true;
+        isBorderVertex[b] = true;
+      }
+
+      i = j;
+    }
+
+    for (std::size_t i{0}; i < edges.size(); ++i) {
+      if (i == 0 || edges[i][0] != edges[i - 1][0] || edges[i][1] != edges[i - 1][1]) {
+        PushCollapse(edges[i][0], edges[i][1]);
+      }
+    }
+  }
+
+  // Returns false when the target cannot be reached, as no collapse is valid anymore
+  bool Simplifier::CollapseUntil(std::size_t targetTriCount) {
+    while (triCount > targetTriCount && !collapses.empty()) {
+      const Collapse collapse{collapses.top()};
+      collapses.pop();
+
+      bool isStale{
+        !isVertexAlive[collapse.v1] || !isVertexAlive[collapse.v2] ||
+        versions[collapse.v1] != collapse.version1 || versions[collapse.v2] != collapse.version2
+      };
+
+      if (!isStale && IsCollapseValid(collapse)) {
+        ApplyCollapse(collapse);
+      }
+    }
+
+    return triCount <= targetTriCount;
+  }
+
+  // The vertices keep the order of the source mesh
+  Mesh Simplifier::Extract() const {
+    constexpr std::size_t kUnused{std::numeric_limits<std::size_t>::max()};
+
+    std::vector<std::size_t> newIds(positions.size(), kUnused);
+    std::vector<Point> normals(positions.size(), Point{0.0, 0.0, 0.0});
+
+    for (std::size_t t{0}; t < tris.size(); ++t) {
+      if (!isTriAlive[t]) {
+        continue;
+      }
+
+      const TriIndices& tri{tris[t]};
+      const Point normal{Cross(positions[tri[1]] - positions[tri[0]], positions[tri[2]] - positions[tri[0]])};
+
+      for (std::size_t v : tri) {
+        normals[v] = normals[v] + normal;    // Weighted by the area of the triangles
+        newIds[v] = 0;
+      }
+    }
+
+    std::vector<Vertex> vertexBuffer;
+    std::vector<TriIndices> indexBuffer;
+    indexBuffer.reserve(triCount);
+
+    for (std::size_t v{0}; v < positions.size(); ++v) {
+      if (newIds[v] == kUnused) {
+        continue;
+      }
+
+      newIds[v] = vertexBuffer.size();
+
+      const double length{Length(normals[v])};
+      const Point normal{length > 0.0 ? normals[v] * (1.0 / length) : normals[v]};
+
+      vertexBuffer.push_back(Vertex{
+        Vector3{static_cast<float>(positions[v].x), static_cast<float>(positions[v].y), static_cast<float>(positions[v].z)},
+        Vector3{static_cast<float>(normal.x), static_cast<float>(normal.y), static_cast<float>(normal.z)}
+      });
+    }
+
+    for (std::size_t t{0}; t < tris.size(); ++t) {
+      if (isTriAlive[t]) {
+        indexBuffer.push_back({newIds[tris[t][0]], newIds[tris[t][1]], newIds[tris[t][2]]});
+      }
+    }
+
+    return Mesh{std::move(vertexBuffer), std::move(indexBuffer)};
+  }
+
+  // The optimal point is only trusted when it stays close to the edge,
+  // otherwise the best of the endpoints and the midpoint is taken
+  void Simplifier::PushCollapse(std::size_t v1, std::size_t v2) {
+    Quadric quadric{quadrics[v1]};
+    quadric += quadrics[v2];
+
+    const Point& p1{positions[v1]};
+    const Point& p2{positions[v2]};
+    const Point midpoint{(p1 + p2) * 0.5};
+
+    Point position;
+    bool isOptimal{quadric.Minimize(position) && Length(position - midpoint) <= Length(p2 - p1)};
+
+    if (!isOptimal) {
+      position = midpoint;
+
+      for (const Point& candidate : {p1, p2}) {
+        if (quadric.Evaluate(candidate) < quadric.Evaluate(position)) {
+          position = candidate;
+        }
+      }
+    }
+
+    collapses.push(Collapse{std::max(quadric.Evaluate(position), 0.0), v1, v2, versions[v1], versions[v2], position});
+  }
+
+  // The collapse must keep the surface manifold (the two vertices can only
+  // share the neighbors opposite to the edge, and an edge joining two
+  // borders cannot be collapsed unless it is on a border itself), and no
+  // triangle can be flipped by the new position
+  bool Simplifier::IsCollapseValid(const Collapse& collapse) {
+    const std::size_t v1{collapse.v1};
+    const std::size_t v2{collapse.v2};
+
+    auto containsBoth = [&](const TriIndices& tri) {
+      return (tri[0] == v1 || tri[1] == v1 || tri[2] == v1) && (tri[0] == v2 || tri[1] == v2 || tri[2] == v2);
+    };
+
+    std::size_t sharedTriCount{0};
+    for (std::size_t t : vertexTris[v1]) {
+      if (isTriAlive[t] && containsBoth(tris[t])) {
+        ++sharedTriCount;
+      }
+    }
+
+    if (sharedTriCount == 0 || (isBorderVertex[v1] && isBorderVertex[v2] && sharedTriCount != 1)) {
+      return false;
+    }
+
+    GatherNeighbors(v1, neighbors1);
+    GatherNeighbors(v2, neighbors2);
+
+    std::size_t commonNeighborCount{0};
+    for (std::size_t i{0}, j{0}; i < neighbors1.size() && j < neighbors2.size();) {
+      if (neighbors1[i] < neighbors2[j]) {
+        ++i;
+      }
+      else if (neighbors2[j] < neighbors1[i]) {
+        ++j;
+      }
+      else {
+        ++commonNeighborCount;
+        ++i;
+        ++j;
+      }
+    }
+
+    if (commonNeighborCount != sharedTriCount) {
+      return false;
+    }
+
+    for (std::size_t v : {v1, v2}) {
+      for (std::size_t t : vertexTris[v]) {
+        if (!isTriAlive[t] || containsBoth(tris[t])) {
+          continue;
+        }
+
+        const TriIndices& tri{tris[t]};
+        Point corners[3];
+
+        for (std::size_t k{0}; k < 3; ++k) {
+          corners[k] = tri[k] == v ? collapse.position : positions[tri[k]];
+        }
+
+        const Point oldNormal{Cross(positions[tri[1]] - positions[tri[0]], positions[tri[2]] - positions[tri[0]])};
+        const Point newNormal{Cross(corners[1] - corners[0], corners[2] - corners[0])};
+
+        if (Dot(oldNormal, newNormal) <= 0.0) {
+          return false;
+        }
+      }
+    }
+
+    return true;
+  }
+
+  void Simplifier::ApplyCollapse(const Collapse& collapse) {
+    const std::size_t v1{collapse.v1};
+    const std::size_t v2{collapse.v2};
+
+    positions[v1] = collapse.position;
+    quadrics[v1] += quadrics[v2];
+    isBorderVertex[v1] = isBorderVertex[v1] || isBorderVertex[v2];
+
+    // The triangles of the edge disappear, the others are moved to v1
+    for (std::size_t t : vertexTris[v2]) {
+      if (!isTriAlive[t]) {
+        continue;
+      }
+
+      TriIndices& tri{tris[t]};
+
+      if (tri[0] == v1 || tri[1] == v1 || tri[2] == v1) {
+        isTriAlive[t] = false;
+        --triCount;
+        continue;
+      }
+
+      std::replace(tri.begin(), tri.end(), v2, v1);
+      vertexTris[v1].push_back(t);
+    }
+
+    auto& trisOfV1{vertexTris[v1]};
+    trisOfV1.erase(std::remove_if(trisOfV1.begin(), trisOfV1.end(), [&](std::size_t t) { return !isTriAlive[t]; }), trisOfV1.end());
+
+    isVertexAlive[v2] = false;
+    vertexTris[v2].clear();
+    ++versions[v1];
+
+    error = std::max(error, std::sqrt(collapse.cost));
+
+    GatherNeighbors(v1, neighbors1);
+    for (std::size_t neighbor : neighbors1) {
+      PushCollapse(v1, neighbor);
+    }
+  }
+
+  // Sorted and without duplicates
+  void Simplifier::GatherNeighbors(std::size_t v, std::vector<std::size_t>& neighbors) const {
+    neighbors.clear();
+
+    for (std::size_t t : vertexTris[v]) {
+      if (!isTriAlive[t]) {
+        continue;
+      }
+
+      for (std::size_t neighbor : tris[t]) {
+        if (neighbor != v) {
+          neighbors.push_back(neighbor);
+        }
+      }
+    }
+
+    std::sort(neighbors.begin(), neighbors.end());
+    neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+  }
+
+  // A level that removes less than a quarter of the triangles of the previous
+  // one is not worth its memory, so the chain stops there
+  std::vector<MeshLod> MeshSimplifier::BuildLodChain(std::shared_ptr<const Mesh> mesh) {
+    if (!mesh) {
+      throw std::invalid_argument("EXCEPTION: a level of detail chain needs a mesh");
+    }
+
+    const bool hasStreams{!mesh->vertexStreams.IsEmpty()};
+    const bool hasMeshlets{!mesh->meshlets.empty()};
+    std::size_t triCount{mesh->indexBuffer.GetSize()};
+
+    std::vector<MeshLod> lods;
+    lods.push_back(MeshLod{mesh, 0.0f});
+
+    if (triCount / 2 < g_LodMinTriCount) {
+      return lods;
+    }
+
+    Simplifier simplifier{*mesh};
+
+    while (lods.size() < g_LodMaxLevelCount && triCount / 2 >= g_LodMinTriCount) {
+      simplifier.CollapseUntil(triCount / 2);
+
+      if (simplifier.triCount > triCount * 3 / 4) {
+        break;
+      }
+
+      Mesh level{simplifier.Extract()};
+
+      if (g_OptimizeVertexCache) {
+        MeshOptimizer::OptimizeVertexCache(level);
+      }
+
+      if (hasMeshlets) {
+        level.BuildMeshlets();
+      }
+
+      if (hasStreams) {
+        level.BuildVertexStreams();
+      }
+
+      triCount = simplifier.triCount;
+      lods.push_back(MeshLod{std::make_shared<const Mesh>(std::move(level)), static_cast<float>(simplifier.error)});
+    }
+
+    return lods;
+  }
+
+}
@@ -0,0 +1,35 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include "entity/component/mesh/mesh.h"
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Simplifies meshes by collapsing edges in order of quadric error (Garland
+// and Heckbert): every vertex accumulates the planes of the triangles around
+// it, and the edge whose collapse moves the surface the least from those
+// planes is collapsed first, into the point that minimizes that distance.
+// Collapses that would fold a triangle over or make the surface
+// non-manifold are skipped, and the open borders are kept in place by
+// additional planes perpendicular to them.
+// The vertices sharing a position are welded before the simplification, so
+// the simplified meshes only have one (averaged) normal per position
+
+namespace engine {
+
+  class MeshSimplifier {
+  public:
+    MeshSimplifier() = delete;
+
+    // Level 0 is the given mesh itself; each next level has about half the
+    // triangles of the previous one, down to g_LodMinTriCount triangles or
+    // g_LodMaxLevelCount levels. The levels have vertex streams and meshlets
+    // if the given mesh has them
+    static std::vector<MeshLod> BuildLodChain(std::shared_ptr<const Mesh> mesh);
+  };
+
+}
+
+#endif
@@ -75,6 +75,10 @@ namespace engine {
 
   const Matrix4x4& Transform::GetModelMatrix() const { return m_ModelMat; }
 
+  bool Transform::IsModelMatrixDirty() const { return m_ModelMatrixDirty; }
+
+  void Transform::ClearModelMatrixDirty() { m_ModelMatrixDirty = false; }
+
   void Transform::ApplyMovement(const Vector3& movement) {
     m_Position += movement;
     UpdateMatrices();
@@ -127,6 +131,7 @@ namespace engine {
     scalingMat.matrix[3][3] = 1.0f;
 
     m_ModelMat = translationMat * m_RotationMat * scalingMat;
+    m_ModelMatrixDirty = true;
   }
 
 }
\ No newline at end of file
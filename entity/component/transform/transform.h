@@ -23,6 +23,9 @@ namespace engine {
     const Vector3 GetForwardDirection() const;
     const Matrix4x4& GetRotationMatrix() const;
     const Matrix4x4& GetModelMatrix() const;
+    bool IsModelMatrixDirty() const;
+
+    void ClearModelMatrixDirty();
 
     // These functions must be used to apply dynamic 
     // transformations frame by frame
@@ -39,6 +42,7 @@ namespace engine {
                               // vertex normals)
     Matrix4x4 m_ModelMat;     // Contains the data relating to location,
                               // rotation, and scale
+    bool m_ModelMatrixDirty;  // Tells when the world space bounds should be updated
 
     void UpdateMatrices();
   };
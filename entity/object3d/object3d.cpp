@@ -1,23 +1,44 @@
 #include "object3d.h"
 
+#include <stdexcept>
+#include <utility>
+
 namespace engine {
 
-  Object3D::Object3D(const Mesh& mesh, const EntityInputData& entityInputData) : 
-    Entity(entityInputData), m_Mesh{std::move(mesh)} 
+  Object3D::Object3D(std::shared_ptr<const Mesh> mesh, const EntityInputData& entityInputData) : 
+    Object3D(std::vector<MeshLod>{MeshLod{std::move(mesh), 0.0f}}, entityInputData)
   {}
 
-  Mesh Object3D::GetTransformedMesh() const {
-    const Matrix4x4 modelMat{m_Transform.GetModelMatrix()};
-    const Matrix4x4 rotationMat{m_Transform.GetRotationMatrix()};
+  Object3D::Object3D(std::vector<MeshLod> lods, const EntityInputData& entityInputData) : 
+    Entity(entityInputData), m_Lods{std::move(lods)}, m_Lod{0} 
+  {
+    if (m_Lods.empty()) {
+      throw std::invalid_argument("EXCEPTION: an object needs a mesh");
+    }
+
+    for (const auto& lod : m_Lods) {
+      if (!lod.mesh) {
+        throw std::invalid_argument("EXCEPTION: an object needs a mesh");
+      }
+    }
+  }
+
+  const Mesh& Object3D::GetMesh(std::size_t lod) const { return *m_Lods.at(lod).mesh; }
+
+  const std::shared_ptr<const Mesh>& Object3D::GetSharedMesh(std::size_t lod) const { return m_Lods.at(lod).mesh; }
+
+  std::size_t Object3D::GetLodCount() const { return m_Lods.size(); }
 
-    Mesh transformedMesh{m_Mesh};
+  float Object3D::GetLodError(std::size_t lod) const { return m_Lods.at(lod).error; }
 
-    for (auto& v : transformedMesh.vertexBuffer) {
-      v.position = modelMat * v.position;
-      v.normal = (rotationMat * v.normal).GetNormalized();    
+  std::size_t Object3D::GetLod() const { return m_Lod; }
+
+  void Object3D::SetLod(std::size_t lod) {
+    if (lod >= m_Lods.size()) {
+      throw std::invalid_argument("EXCEPTION: the object does not have this level of detail");
     }
-      
-    return std::move(transformedMesh);
+
+    m_Lod = lod;
   }
   
 }
@@ -5,17 +5,36 @@
 #include "entity/component/mesh/mesh.h"
 #include "geometry/primitive.h"
 
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// The mesh of an object is an immutable resource which can be shared by any
+// number of objects (instances): each of them only adds its own Transform.
+// An object can have several levels of detail of its mesh (level 0 being
+// the full-detail one): the geometry processing selects the one to render
+// every frame, while everything else (e.g. the BVH) uses level 0
+
 namespace engine {
   
   class Object3D : public Entity {
   public:
-    Object3D(const Mesh& mesh, const EntityInputData& entityInputData = EntityInputData{});
+    Object3D(std::shared_ptr<const Mesh> mesh, const EntityInputData& entityInputData = EntityInputData{});
+    Object3D(std::vector<MeshLod> lods, const EntityInputData& entityInputData = EntityInputData{});
+
+    // Getters
+    const Mesh& GetMesh(std::size_t lod = 0) const;
+    const std::shared_ptr<const Mesh>& GetSharedMesh(std::size_t lod = 0) const;
+    std::size_t GetLodCount() const;
+    float GetLodError(std::size_t lod) const;
+    std::size_t GetLod() const;         // Level selected for rendering
 
-    // Getter
-    Mesh GetTransformedMesh() const;
+    // Setter
+    void SetLod(std::size_t lod);
 
   private:
-    Mesh m_Mesh;
+    std::vector<MeshLod> m_Lods;
+    std::size_t m_Lod;
   };
   
 }
@@ -0,0 +1,126 @@
+#include "bounding_volume.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace engine {
+
+  Aabb Aabb::FromVertices(const std::vector<Vertex>& vertexBuffer) {
+    if (vertexBuffer.empty()) {
+      return Aabb{};
+    }
+
+    Aabb aabb{vertexBuffer[0].position, vertexBuffer[0].position};
+
+    for (const auto& vertex : vertexBuffer) {
+      const Vector3& p{vertex.position};
+
+      aabb.min = Vector3{std::min(aabb.min.x, p.x), std::min(aabb.min.y, p.y), std::min(aabb.min.z, p.z)};
+      aabb.max = Vector3{std::max(aabb.max.x, p.x), std::max(aabb.max.y, p.y), std::max(aabb.max.z, p.z)};
+    }
+
+    return aabb;
+  }
+
+  Aabb Aabb::GetUnion(const Aabb& aabb1, const Aabb& aabb2) {
+    return Aabb{
+      Vector3{std::min(aabb1.min.x, aabb2.min.x), std::min(aabb1.min.y, aabb2.min.y), std::min(aabb1.min.z, aabb2.min.z)},
+      Vector3{std::max(aabb1.max.x, aabb2.max.x), std::max(aabb1.max.y, aabb2.max.y), std::max(aabb1.max.z, aabb2.max.z)}
+    };
+  }
+
+  Aabb Aabb::GetIntersection(const Aabb& aabb1, const Aabb& aabb2) {
+    return Aabb{
+      Vector3{std::max(aabb1.min.x, aabb2.min.x), std::max(aabb1.min.y, aabb2.min.y), std::max(aabb1.min.z, aabb2.min.z)},
+      Vector3{std::min(aabb1.max.x, aabb2.max.x), std::min(aabb1.max.y, aabb2.max.y), std::min(aabb1.max.z, aabb2.max.z)}
+    };
+  }
+
+  Vector3 Aabb::GetCenter() const { return (min + max) * 0.5f; }
+
+  // The center is transformed as a point, while each half extent of the new
+  // box is the sum of the absolute values of a row of the linear part times
+  // the half extents of the box (Arvo)
+  Aabb Aabb::GetTransformed(const Matrix4x4& mat) const {
+    const auto& m{mat.matrix};
+
+    const Vector3 center{mat * GetCenter()};
+    const Vector3 halfExtents{(max - min) * 0.5f};
+
+    const Vector3 newHalfExtents{
+      std::abs(m[0][0]) * halfExtents.x + std::abs(m[0][1]) * halfExtents.y + std::abs(m[0][2]) * halfExtents.z,
+      std::abs(m[1][0]) * halfExtents.x + std::abs(m[1][1]) * halfExtents.y + std::abs(m[1][2]) * halfExtents.z,
+      std::abs(m[2][0]) * halfExtents.x + std::abs(m[2][1]) * halfExtents.y + std::abs(m[2][2]) * halfExtents.z
+    };
+
+    return Aabb{center - newHalfExtents, center + newHalfExtents};
+  }
+
+  // Slab test: the ray is inside the box where it is inside the three slabs
+  bool Aabb::IntersectsRay(const Vector3& origin, const Vector3& inverseDirection, float maxDistance, float& distance) const {
+    float tMin{0.0f};
+    float tMax{maxDistance};
+
+    const float origins[3]{origin.x, origin.y, origin.z};
+    const float inverses[3]{inverseDirection.x, inverseDirection.y, inverseDirection.z};
+    const float mins[3]{min.x, min.y, min.z};
+    const float maxs[3]{max.x, max.y, max.z};
+
+    for (std::size_t i{0}; i < 3; ++i) {
+      float t0{(mins[i] - origins[i]) * inverses[i]};
+      float t1{(maxs[i] - origins[i]) * inverses[i]};
+
+      if (t0 > t1) {
+        std::swap(t0, t1);
+      }
+
+      tMin = std::max(tMin, t0);
+      tMax = std::min(tMax, t1);
+
+      if (tMin > tMax) {
+        return false;
+      }
+    }
+
+    distance = tMin;
+    return true;
+  }
+
+  bool Aabb::operator==(const Aabb& aabb) const { return min == aabb.min && max == aabb.max; }
+
+  BoundingSphere BoundingSphere::FromVertices(const std::vector<Vertex>& vertexBuffer, const Aabb& aabb) {
+    BoundingSphere sphere{aabb.GetCenter(), 0.0f};
+
+    float maxSquaredDistance{0.0f};
+
+    for (const auto& vertex : vertexBuffer) {
+      const Vector3 d{vertex.position - sphere.center};
+      maxSquaredDistance = std::max(maxSquaredDistance, d.x * d.x + d.y * d.y + d.z * d.z);
+    }
+
+    sphere.radius = std::sqrt(maxSquaredDistance);
+
+    return sphere;
+  }
+
+  // The radius grows with the largest scale of the matrix
+  BoundingSphere BoundingSphere::GetTransformed(const Matrix4x4& mat) const {
+    const auto& m{mat.matrix};
+
+    const float maxScale{std::max({
+      Vector3{m[0][0], m[1][0], m[2][0]}.GetModule(),
+      Vector3{m[0][1], m[1][1], m[2][1]}.GetModule(),
+      Vector3{m[0][2], m[1][2], m[2][2]}.GetModule()
+    })};
+
+    return BoundingSphere{mat * center, radius * maxScale};
+  }
+
+  Aabb BoundingSphere::GetAabb() const {
+    const Vector3 halfExtents{radius, radius, radius};
+
+    return Aabb{center - halfExtents, center + halfExtents};
+  }
+
+}
@@ -0,0 +1,45 @@
+#ifndef BOUNDING_VOLUME_H
+#define BOUNDING_VOLUME_H
+
+#include "geometry/primitive.h"
+
+#include <vector>
+
+// Volumes enclosing a set of points, used to reject whole objects before
+// their vertices are processed
+
+namespace engine {
+
+  // Axis-aligned bounding box
+  struct Aabb {
+    Vector3 min;
+    Vector3 max;
+
+    static Aabb FromVertices(const std::vector<Vertex>& vertexBuffer);
+    static Aabb GetUnion(const Aabb& aabb1, const Aabb& aabb2);
+    static Aabb GetIntersection(const Aabb& aabb1, const Aabb& aabb2);
+
+    Vector3 GetCenter() const;
+    Aabb GetTransformed(const Matrix4x4& mat) const;    // Box enclosing the transformed box (affine mat only)
+
+    // Distance along the ray at which it enters the box, if it does before maxDistance.
+    // inverseDirection holds 1 / direction for each axis
+    bool IntersectsRay(const Vector3& origin, const Vector3& inverseDirection, float maxDistance, float& distance) const;
+
+    bool operator==(const Aabb& aabb) const;
+  };
+
+  struct BoundingSphere {
+    Vector3 center;
+    float radius{0.0f};
+
+    // Centered in the box, so it is not the smallest possible sphere
+    static BoundingSphere FromVertices(const std::vector<Vertex>& vertexBuffer, const Aabb& aabb);
+
+    BoundingSphere GetTransformed(const Matrix4x4& mat) const;    // Affine mat only
+    Aabb GetAabb() const;
+  };
+
+}
+
+#endif
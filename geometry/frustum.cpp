@@ -0,0 +1,88 @@
+#include "frustum.h"
+
+#include "math/math.h"
+
+namespace engine {
+
+  float Plane::GetDistance(const Vector3& point) const {
+    return Math::DotProduct(normal, point) + offset;
+  }
+
+  // Each plane is a combination of the rows of the matrix (Gribb-Hartmann):
+  // for instance x >= -w becomes dot(row3 + row0, p) >= 0
+  Frustum::Frustum(const Matrix4x4& clipMat) {
+    const auto& m{clipMat.matrix};
+
+    auto getPlane = [&](std::size_t row, float sign) {
+      return Plane{
+        Vector3{m[3][0] + sign * m[row][0], m[3][1] + sign * m[row][1], m[3][2] + sign * m[row][2]},
+        m[3][3] + sign * m[row][3]
+      };
+    };
+
+    m_Planes[0] = getPlane(0, 1.0f);
+    m_Planes[1] = getPlane(0, -1.0f);
+    m_Planes[2] = getPlane(1, 1.0f);
+    m_Planes[3] = getPlane(1, -1.0f);
+    m_Planes[4] = Plane{Vector3{m[2][0], m[2][1], m[2][2]}, m[2][3]};
+    m_Planes[5] = getPlane(2, -1.0f);
+  }
+
+  bool Frustum::IsOutside(const BoundingSphere& sphere) const {
+    for (const auto& plane : m_Planes) {
+      if (plane.GetDistance(sphere.center) < -sphere.radius) {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  // The box is outside when, for some plane, even its corner that is furthest
+  // along the normal lies behind it
+  bool Frustum::IsOutside(const Aabb& aabb) const {
+    for (const auto& plane : m_Planes) {
+      const Vector3 corner{
+        plane.normal.x >= 0.0f ? aabb.max.x : aabb.min.x,
+        plane.normal.y >= 0.0f ? aabb.max.y : aabb.min.y,
+        plane.normal.z >= 0.0f ? aabb.max.z : aabb.min.z
+      };
+
+      if (plane.GetDistance(corner) < 0.0f) {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  // The box is inside when, for every plane, even its corner that is furthest
+  // against the normal lies in front of it
+  bool Frustum::Contains(const Aabb& aabb) const {
+    for (const auto& plane : m_Planes) {
+      const Vector3 corner{
+        plane.normal.x >= 0.0f ? aabb.min.x : aabb.max.x,
+        plane.normal.y >= 0.0f ? aabb.min.y : aabb.max.y,
+        plane.normal.z >= 0.0f ? aabb.min.z : aabb.max.z
+      };
+
+      if (plane.GetDistance(corner) < 0.0f) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  void Frustum::Normalize() {
+    for (auto& plane : m_Planes) {
+      float module{plane.normal.GetModule()};
+
+      if (module > 0.0f) {
+        plane.normal /= module;
+        plane.offset /= module;
+      }
+    }
+  }
+
+}
@@ -0,0 +1,43 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include "geometry/bounding_volume.h"
+#include "geometry/primitive.h"
+
+#include <array>
+
+// The volume seen by the camera, as six planes whose normals point inwards.
+// The planes are extracted from the matrix that maps points into clip space,
+// where the visible points satisfy -w <= x <= w, -w <= y <= w and 0 <= z <= w.
+// The space of the planes is the input space of the matrix: the view-projection
+// matrix gives world space planes, the model-view-projection one gives object
+// space planes
+
+namespace engine {
+
+  struct Plane {
+    Vector3 normal;
+    float offset{0.0f};
+
+    float GetDistance(const Vector3& point) const;    // Signed, scaled by the module of the normal
+  };
+
+  class Frustum {
+  public:
+    // clipMat uses the Matrix4x4 * Vector3 convention
+    explicit Frustum(const Matrix4x4& clipMat);
+
+    // Conservative tests: a volume crossing a corner of the frustum may be kept
+    bool IsOutside(const BoundingSphere& sphere) const;   // Needs normalized planes (see Normalize())
+    bool IsOutside(const Aabb& aabb) const;
+    bool Contains(const Aabb& aabb) const;
+
+    void Normalize();
+
+  private:
+    std::array<Plane, 6> m_Planes;    // Left, right, top, bottom, near, far
+  };
+
+}
+
+#endif
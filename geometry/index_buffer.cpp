@@ -0,0 +1,73 @@
+#include "index_buffer.h"
+
+#include <utility>
+
+namespace engine {
+
+  IndexBuffer::IndexBuffer() : m_Type{IndexType::UInt32} {}
+
+  IndexBuffer::IndexBuffer(const std::vector<std::array<std::size_t, 3>>& tris, std::size_t vertexCount) : 
+    m_Type{tris.empty() ? IndexType::UInt32 : GetSmallestType(vertexCount)}
+  {
+    Visit([&](auto& typedTris) {
+      using Index = typename std::decay_t<decltype(typedTris)>::value_type::value_type;
+
+      typedTris.resize(tris.size());
+
+      for (std::size_t i{0}; i < tris.size(); ++i) {
+        typedTris[i] = {static_cast<Index>(tris[i][0]), static_cast<Index>(tris[i][1]), static_cast<Index>(tris[i][2])};
+      }
+    });
+  }
+
+  IndexBuffer::IndexBuffer(std::vector<IndexTriple<std::uint16_t>> tris) : 
+    m_Type{IndexType::UInt16}, m_Tris16{std::move(tris)} 
+  {}
+
+  IndexBuffer::IndexBuffer(std::vector<IndexTriple<std::uint32_t>> tris) : 
+    m_Type{IndexType::UInt32}, m_Tris32{std::move(tris)} 
+  {}
+
+  IndexType IndexBuffer::GetType() const { return m_Type; }
+
+  std::size_t IndexBuffer::GetSize() const {
+    return Visit([](const auto& tris) { return tris.size(); });
+  }
+
+  std::size_t IndexBuffer::GetCapacity() const {
+    return Visit([](const auto& tris) { return tris.capacity(); });
+  }
+
+  std::size_t IndexBuffer::GetByteSize() const {
+    return Visit([](const auto& tris) { return tris.size() * sizeof(tris[0]); });
+  }
+
+  bool IndexBuffer::IsEmpty() const { return GetSize() == 0; }
+
+  std::array<std::size_t, 3> IndexBuffer::GetTri(std::size_t i) const {
+    return Visit([i](const auto& tris) { 
+      return std::array<std::size_t, 3>{tris[i][0], tris[i][1], tris[i][2]}; 
+    });
+  }
+
+  std::vector<std::array<std::size_t, 3>> IndexBuffer::GetWideTris() const {
+    std::vector<std::array<std::size_t, 3>> wideTris(GetSize());
+
+    for (std::size_t i{0}; i < wideTris.size(); ++i) {
+      wideTris[i] = GetTri(i);
+    }
+
+    return wideTris;
+  }
+
+  void IndexBuffer::Clear() {
+    m_Tris16.clear();
+    m_Tris32.clear();
+  }
+
+  // 0xFFFF is left out, as it is commonly reserved (e.g. primitive restart)
+  IndexType IndexBuffer::GetSmallestType(std::size_t vertexCount) {
+    return vertexCount <= std::numeric_limits<std::uint16_t>::max() ? IndexType::UInt16 : IndexType::UInt32;
+  }
+
+}
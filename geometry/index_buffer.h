@@ -0,0 +1,109 @@
+#ifndef INDEX_BUFFER_H
+#define INDEX_BUFFER_H
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+// Triangles of a mesh, stored with 16-bit indices when every vertex can be
+// addressed by them and with 32-bit indices otherwise, instead of 24 bytes
+// per triangle. The loops over the triangles are generic over the index
+// type: Visit() calls them with the buffer of the actual type, so the type
+// is checked once per mesh instead of once per triangle.
+// An empty buffer is 32-bit, as it is usually an output (e.g. the processed
+// mesh) that can receive any number of vertices
+
+namespace engine {
+
+  enum class IndexType {
+    UInt16,
+    UInt32
+  };
+
+  template <typename Index>
+  using IndexTriple = std::array<Index, 3>;
+
+  class IndexBuffer {
+  public:
+    IndexBuffer();
+    IndexBuffer(const std::vector<std::array<std::size_t, 3>>& tris, std::size_t vertexCount);
+    explicit IndexBuffer(std::vector<IndexTriple<std::uint16_t>> tris);
+    explicit IndexBuffer(std::vector<IndexTriple<std::uint32_t>> tris);
+
+    // Getters
+    IndexType GetType() const;
+    std::size_t GetSize() const;                        // Triangles
+    std::size_t GetCapacity() const;                    // Triangles
+    std::size_t GetByteSize() const;
+    bool IsEmpty() const;
+    std::array<std::size_t, 3> GetTri(std::size_t i) const;
+    std::vector<std::array<std::size_t, 3>> GetWideTris() const;
+
+    // The requested type must be the type of the buffer
+    template <typename Index>
+    std::vector<IndexTriple<Index>>& GetTris();
+
+    template <typename Index>
+    const std::vector<IndexTriple<Index>>& GetTris() const;
+
+    void Clear();                                       // Keeps the type and the capacity
+
+    // Calls function with the vector of IndexTriple of the actual type
+    template <typename Function>
+    decltype(auto) Visit(Function&& function);
+
+    template <typename Function>
+    decltype(auto) Visit(Function&& function) const;
+
+    static IndexType GetSmallestType(std::size_t vertexCount);
+
+  private:
+    IndexType m_Type;
+    std::vector<IndexTriple<std::uint16_t>> m_Tris16;
+    std::vector<IndexTriple<std::uint32_t>> m_Tris32;
+  };
+
+  template <typename Index>
+  std::vector<IndexTriple<Index>>& IndexBuffer::GetTris() {
+    static_assert(std::is_same_v<Index, std::uint16_t> || std::is_same_v<Index, std::uint32_t>);
+
+    if constexpr (std::is_same_v<Index, std::uint16_t>) {
+      assert(m_Type == IndexType::UInt16);
+      return m_Tris16;
+    }
+    else {
+      assert(m_Type == IndexType::UInt32);
+      return m_Tris32;
+    }
+  }
+
+  template <typename Index>
+  const std::vector<IndexTriple<Index>>& IndexBuffer::GetTris() const {
+    return const_cast<IndexBuffer*>(this)->GetTris<Index>();
+  }
+
+  template <typename Function>
+  decltype(auto) IndexBuffer::Visit(Function&& function) {
+    if (m_Type == IndexType::UInt16) {
+      return function(m_Tris16);
+    }
+
+    return function(m_Tris32);
+  }
+
+  template <typename Function>
+  decltype(auto) IndexBuffer::Visit(Function&& function) const {
+    if (m_Type == IndexType::UInt16) {
+      return function(m_Tris16);
+    }
+
+    return function(m_Tris32);
+  }
+
+}
+
+#endif
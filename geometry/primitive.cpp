@@ -203,6 +203,19 @@ namespace engine {
 
   Matrix4x4::Matrix4x4() : matrix{} {}
 
+  // Vector3 * Matrix4x4 gives the same result as GetTransposed() * Vector3
+  Matrix4x4 Matrix4x4::GetTransposed() const {
+    Matrix4x4 result{};
+
+    for (std::size_t i{0}; i < result.matrix.size(); ++i) {
+      for (std::size_t j{0}; j < result.matrix[0].size(); ++j) {
+        result.matrix[i][j] = matrix[j][i];
+      }
+    }
+
+    return result;
+  }
+
   Matrix4x4 Matrix4x4::operator+(const Matrix4x4& mat) const {
     Matrix4x4 result{};
 
@@ -212,7 +225,7 @@ namespace engine {
       }
     }
 
-    return std::move(result);
+    return result;
   }
 
   Matrix4x4 Matrix4x4::operator-(const Matrix4x4& mat) const {
@@ -224,7 +237,7 @@ namespace engine {
       }
     }
 
-    return std::move(result);
+    return result;
   }
 
   Matrix4x4 Matrix4x4::operator*(const Matrix4x4& mat) const {
@@ -238,7 +251,7 @@ namespace engine {
       }
     }
 
-    return std::move(result);
+    return result;
   }
 
   Vector3 Matrix4x4::operator*(const Vector3& vec) const {
@@ -276,7 +289,7 @@ namespace engine {
       }
     }
 
-    return std::move(result);
+    return result;
   }
 
   Matrix4x4 Matrix4x4::operator/(float val) const {
@@ -294,7 +307,7 @@ namespace engine {
       }
     }
 
-    return std::move(result);
+    return result;
   }
 
   Matrix4x4& Matrix4x4::operator+=(const Matrix4x4& mat) {
@@ -352,7 +365,7 @@ namespace engine {
       }
     }
 
-    return std::move(result);
+    return result;
   }
 
   bool Matrix4x4::operator==(const Matrix4x4& mat) const {
@@ -66,6 +66,8 @@ namespace engine {
 
     Matrix4x4();
 
+    Matrix4x4 GetTransposed() const;
+
     // Operators overloading
     Matrix4x4 operator+(const Matrix4x4& mat) const;
     Matrix4x4 operator-(const Matrix4x4& mat) const;
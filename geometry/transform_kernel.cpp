@@ -0,0 +1,171 @@
+#include "transform_kernel.h"
+
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define ENGINE_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace engine {
+
+  using TransformFunction = bool (*)(const Matrix4x4& mat, const StreamTransformData& data, std::size_t first);
+
+  constexpr float k_Epsilon{std::numeric_limits<float>::epsilon()};
+
+  // Transforms the vertices from first to data.count. Returns false if w was 
+  // zero for any of them
+  static bool TransformScalar(const Matrix4x4& mat, const StreamTransformData& data, std::size_t first) {
+    const auto& m{mat.matrix};
+    bool isValid{true};
+
+    for (std::size_t i{first}; i < data.count; ++i) {
+      const float x{data.inX[i]}, y{data.inY[i]}, z{data.inZ[i]};
+
+      float rx{m[0][0] * x + m[0][1] * y + m[0][2] * z + m[0][3]};
+      float ry{m[1][0] * x + m[1][1] * y + m[1][2] * z + m[1][3]};
+      float rz{m[2][0] * x + m[2][1] * y + m[2][2] * z + m[2][3]};
+      float w{m[3][0] * x + m[3][1] * y + m[3][2] * z + m[3][3]};
+
+      if (std::abs(w) < k_Epsilon) {
+        isValid = false;
+        continue;
+      }
+
+      rx /= w;
+      ry /= w;
+      rz /= w;
+
+      data.outX[i] = rx;
+      data.outY[i] = ry;
+      data.outZ[i] = rz;
+    }
+
+    return isValid;
+  }
+
+#ifdef ENGINE_X86_KERNELS
+
+  // SSE2 is part of the x86-64 baseline, so no target attribute is needed
+  static bool TransformSse(const Matrix4x4& mat, const StreamTransformData& data, std::size_t first) {
+    const auto& m{mat.matrix};
+
+    __m128 row[4][4];
+    for (int i{0}; i < 4; ++i) {
+      for (int j{0}; j < 4; ++j) {
+        row[i][j] = _mm_set1_ps(m[i][j]);
+      }
+    }
+
+    const __m128 signMask{_mm_set1_ps(-0.0f)};
+    const __m128 epsilon{_mm_set1_ps(k_Epsilon)};
+    __m128 invalid{_mm_setzero_ps()};
+
+    std::size_t i{first};
+
+    for (; i + 4 <= data.count; i += 4) {
+      const __m128 x{_mm_loadu_ps(data.inX + i)};
+      const __m128 y{_mm_loadu_ps(data.inY + i)};
+      const __m128 z{_mm_loadu_ps(data.inZ + i)};
+
+      __m128 r[4];
+      for (int k{0}; k < 4; ++k) {
+        r[k] = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+          _mm_mul_ps(row[k][0], x), _mm_mul_ps(row[k][1], y)), _mm_mul_ps(row[k][2], z)), row[k][3]);
+      }
+
+      invalid = _mm_or_ps(invalid, _mm_cmplt_ps(_mm_andnot_ps(signMask, r[3]), epsilon));
+
+      r[0] = _mm_div_ps(r[0], r[3]);
+      r[1] = _mm_div_ps(r[1], r[3]);
+      r[2] = _mm_div_ps(r[2], r[3]);
+
+      _mm_storeu_ps(data.outX + i, r[0]);
+      _mm_storeu_ps(data.outY + i, r[1]);
+      _mm_storeu_ps(data.outZ + i, r[2]);
+    }
+
+    bool isValid{TransformScalar(mat, data, i)};
+
+    return isValid && _mm_movemask_ps(invalid) == 0;
+  }
+
+  __attribute__((target("avx")))
+  static bool TransformAvx(const Matrix4x4& mat, const StreamTransformData& data, std::size_t first) {
+    const auto& m{mat.matrix};
+
+    __m256 row[4][4];
+    for (int i{0}; i < 4; ++i) {
+      for (int j{0}; j < 4; ++j) {
+        row[i][j] = _mm256_set1_ps(m[i][j]);
+      }
+    }
+
+    const __m256 signMask{_mm256_set1_ps(-0.0f)};
+    const __m256 epsilon{_mm256_set1_ps(k_Epsilon)};
+    __m256 invalid{_mm256_setzero_ps()};
+
+    std::size_t i{first};
+
+    for (; i + 8 <= data.count; i += 8) {
+      const __m256 x{_mm256_loadu_ps(data.inX + i)};
+      const __m256 y{_mm256_loadu_ps(data.inY + i)};
+      const __m256 z{_mm256_loadu_ps(data.inZ + i)};
+
+      __m256 r[4];
+      for (int k{0}; k < 4; ++k) {
+        r[k] = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(
+          _mm256_mul_ps(row[k][0], x), _mm256_mul_ps(row[k][1], y)), _mm256_mul_ps(row[k][2], z)), row[k][3]);
+      }
+
+      invalid = _mm256_or_ps(invalid, _mm256_cmp_ps(_mm256_andnot_ps(signMask, r[3]), epsilon, _CMP_LT_OQ));
+
+      r[0] = _mm256_div_ps(r[0], r[3]);
+      r[1] = _mm256_div_ps(r[1], r[3]);
+      r[2] = _mm256_div_ps(r[2], r[3]);
+
+      _mm256_storeu_ps(data.outX + i, r[0]);
+      _mm256_storeu_ps(data.outY + i, r[1]);
+      _mm256_storeu_ps(data.outZ + i, r[2]);
+    }
+
+    bool isValid{TransformScalar(mat, data, i)};
+
+    return isValid && _mm256_movemask_ps(invalid) == 0;
+  }
+
+#endif
+
+  static TransformFunction SelectTransformFunction() {
+#ifdef ENGINE_X86_KERNELS
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx")) {
+      return TransformAvx;
+    }
+
+    return TransformSse;
+#else
+    return TransformScalar;
+#endif
+  }
+
+  static const TransformFunction s_TransformFunction{SelectTransformFunction()};
+
+  void TransformKernel::TransformPoints(const Matrix4x4& mat, const StreamTransformData& data) {
+    if (!s_TransformFunction(mat, data, 0)) {
+      throw std::invalid_argument("EXCEPTION: cannot divide by zero");
+    }
+  }
+
+  const char* TransformKernel::GetTypeName() {
+#ifdef ENGINE_X86_KERNELS
+    return s_TransformFunction == TransformAvx ? "avx" : "sse";
+#else
+    return "scalar";
+#endif
+  }
+  
+}
@@ -0,0 +1,40 @@
+#ifndef TRANSFORM_KERNEL_H
+#define TRANSFORM_KERNEL_H
+
+#include "geometry/primitive.h"
+
+#include <cstddef>
+
+// This script transforms whole streams of vertices stored in the
+// structure-of-arrays layout (see VertexStreams). The SSE and AVX versions
+// process 4 and 8 vertices per iteration and perform the same operations,
+// in the same order, as Matrix4x4 * Vector3, so every version gives the
+// same result. The best version supported by the CPU is chosen at runtime
+
+namespace engine {
+
+  struct StreamTransformData {
+    const float* inX;
+    const float* inY;
+    const float* inZ;
+    float* outX;          // The output may alias the input
+    float* outY;
+    float* outZ;
+    std::size_t count;
+  };
+
+  class TransformKernel {
+  public:
+    TransformKernel() = delete;
+
+    // Computes mat * (x, y, z, 1) and divides it by w, like Matrix4x4 * Vector3.
+    // Throws if w is zero for any vertex
+    static void TransformPoints(const Matrix4x4& mat, const StreamTransformData& data);
+
+    // Getter
+    static const char* GetTypeName();
+  };
+  
+}
+
+#endif
@@ -0,0 +1,37 @@
+#include "vertex_streams.h"
+
+namespace engine {
+
+  std::size_t VertexStreams::GetSize() const { return px.size(); }
+
+  bool VertexStreams::IsEmpty() const { return px.empty(); }
+
+  Vector3 VertexStreams::GetPosition(std::size_t index) const {
+    return Vector3{px[index], py[index], pz[index]};
+  }
+
+  void VertexStreams::Reserve(std::size_t capacity) {
+    px.reserve(capacity);
+    py.reserve(capacity);
+    pz.reserve(capacity);
+  }
+
+  void VertexStreams::Resize(std::size_t size) {
+    px.resize(size);
+    py.resize(size);
+    pz.resize(size);
+  }
+
+  void VertexStreams::Clear() { Resize(0); }
+
+  void VertexStreams::CopyFrom(const std::vector<Vertex>& vertexBuffer) {
+    Resize(vertexBuffer.size());
+
+    for (std::size_t i{0}; i < vertexBuffer.size(); ++i) {
+      px[i] = vertexBuffer[i].position.x;
+      py[i] = vertexBuffer[i].position.y;
+      pz[i] = vertexBuffer[i].position.z;
+    }
+  }
+  
+}
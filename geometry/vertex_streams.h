@@ -0,0 +1,67 @@
+#ifndef VERTEX_STREAMS_H
+#define VERTEX_STREAMS_H
+
+#include "geometry/primitive.h"
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+// Structure-of-arrays layout of the positions of a vertex buffer: each
+// coordinate is stored in its own aligned array, so that consecutive
+// vertices can be loaded straight into SIMD registers
+
+namespace engine {
+
+  // Allocates memory aligned to the given number of bytes
+  template <typename T, std::size_t Alignment>
+  class AlignedAllocator {
+  public:
+    using value_type = T;
+
+    template <typename U>
+    struct rebind {
+      using other = AlignedAllocator<U, Alignment>;
+    };
+
+    AlignedAllocator() = default;
+
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+    T* allocate(std::size_t count) {
+      return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t{Alignment}));
+    }
+
+    void deallocate(T* ptr, std::size_t) { ::operator delete(ptr, std::align_val_t{Alignment}); }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U, Alignment>&) const { return false; }
+  };
+
+  constexpr std::size_t k_StreamAlignment{32};    // Size of an AVX register
+
+  using AlignedFloatVector = std::vector<float, AlignedAllocator<float, k_StreamAlignment>>;
+
+  struct VertexStreams {
+    AlignedFloatVector px, py, pz;    // Positions
+
+    // Getters
+    std::size_t GetSize() const;
+    bool IsEmpty() const;
+    Vector3 GetPosition(std::size_t index) const;
+
+    void Reserve(std::size_t capacity);
+    void Resize(std::size_t size);
+    void Clear();
+
+    // Conversion from the array-of-structures layout
+    void CopyFrom(const std::vector<Vertex>& vertexBuffer);
+  };
+  
+}
+
+#endif
@@ -1,34 +1,138 @@
 #include "geometry_processing.h"
 
+#include "geometry/transform_kernel.h"
 #include "math/math.h"
+#include "profiler/profiler.h"
+#include "settings.h"
 
-#include <array>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
 #include <vector>
 
-// TO-DO: add clipping operations right after HandleBackfaceCulling()
-
 namespace engine {
+  // REMEMBER: the following structs and functions are used exclusively inside this file
+
+  // Each clip plane adds at most one vertex to the polygon
+  constexpr std::size_t k_MaxClipPolygonSize{8};
+
+  // Index of the vertices created by the clipping until they are added to the processed mesh
+  constexpr std::size_t k_NewVertex{std::numeric_limits<std::size_t>::max()};
+
+  // Fraction of g_LodPixelError below which a coarser level is selected, so
+  // that an object at the threshold distance does not switch every frame
+  constexpr float k_LodHysteresis{0.75f};
+
+  struct PolygonVertex {
+    ClipVertex position;
+    std::size_t index;    // In the processed mesh
+  };
+
+  static float GetClipDistance(const ClipPlane& plane, const ClipVertex& v) {
+    return plane.a * v.x + plane.b * v.y + plane.c * v.z + plane.d * v.w;
+  }
+
+  static ClipVertex InterpolateClipVertex(const ClipVertex& v1, const ClipVertex& v2, float t) {
+    return ClipVertex{
+      v1.x + (v2.x - v1.x) * t,
+      v1.y + (v2.y - v1.y) * t,
+      v1.z + (v2.z - v1.z) * t,
+      v1.w + (v2.w - v1.w) * t
+    };
+  }
     
-  GeometryProcessing::GeometryProcessing(const Screen& screen) : m_Screen{screen} {}
+  GeometryProcessing::GeometryProcessing(const Screen& screen) : m_Screen{screen}, m_ProcessedMesh{{}, IndexBuffer{}} {}
+
+  const Mesh& GeometryProcessing::GetProcessedMesh(Scene& scene) {
+    ScopedTimer timer{ProfilerStage::ProcessMesh};
 
-  Mesh GeometryProcessing::GetProcessedMesh(Scene& scene) {
     CalculateViewMatrix(scene.camera);
 
     if (scene.camera.IsProjectionDirty()) {
       CalculateProjectionMatrix(scene.camera);
     }
 
-    Mesh processedMesh = scene.object3D.GetTransformedMesh();
+    CalculateClipPlanes();
+    HandleFrustumCulling(scene, m_VisibleObjects);
+
+    if (g_UseLods) {
+      HandleLodSelection(scene, m_VisibleObjects);
+    }
+
+    // The SoA path is taken only when every object has its streams, as the
+    // processed mesh stores its positions in a single layout. Level 0 is the
+    // largest one, so the buffers are sized for it whatever level is selected
+    bool useStreams{true};
+    std::size_t totalVertexCount{0};
+    std::size_t totalTriCount{0};
+    std::size_t maxVertexCount{0};
+    std::size_t maxTriCount{0};
+
+    for (const auto& object3D : scene.objects) {
+      useStreams = useStreams && !object3D.GetMesh().vertexStreams.IsEmpty();
+      totalVertexCount += object3D.GetMesh().vertexBuffer.size();
+      totalTriCount += object3D.GetMesh().indexBuffer.GetSize();
+      maxVertexCount = std::max(maxVertexCount, object3D.GetMesh().vertexBuffer.size());
+      maxTriCount = std::max(maxTriCount, object3D.GetMesh().indexBuffer.GetSize());
+    }
+
+    // Clipping adds at most k_MaxClipPolygonSize vertices per triangle, and
+    // splits it into at most k_MaxClipPolygonSize - 2 triangles. The buffers
+    // are sized for the worst case, so that an object starting to cross the
+    // clip planes does not allocate either
+    const std::size_t maxProcessedVertexCount{totalVertexCount + k_MaxClipPolygonSize * totalTriCount};
+    const std::size_t maxProcessedTriCount{(k_MaxClipPolygonSize - 2) * totalTriCount};
+
+    // The clipping buffers are sized for the largest mesh
+    m_ClipVertices.reserve(maxVertexCount);
+    m_ClippedTris.reserve((k_MaxClipPolygonSize - 2) * maxTriCount);
+    m_ClippedTriNormals.reserve((k_MaxClipPolygonSize - 2) * maxTriCount);
+
+    // The capacity is enough for the whole scene, so appending never allocates
+    m_ProcessedMesh.indexBuffer.Clear();
+    m_ProcessedMesh.indexBuffer.GetTris<std::uint32_t>().reserve(maxProcessedTriCount);
+    m_ProcessedMesh.triNormals.clear();
+    m_ProcessedMesh.triNormals.reserve(maxProcessedTriCount);
+    m_ProcessedMesh.triBrightness.reserve(maxProcessedTriCount);
+
+    // Otherwise Mesh::GetPosition() would read the layout of a previous frame
+    m_ProcessedMesh.vertexStreams.Clear();
+    m_ProcessedMesh.vertexBuffer.clear();
+
+    if (useStreams) {
+      m_ProcessedMesh.vertexStreams.Reserve(maxProcessedVertexCount);
+    }
+    else {
+      m_ProcessedMesh.vertexBuffer.reserve(maxProcessedVertexCount);
+    }
+
+    std::size_t vertexOffset{0};
+
+    m_InstanceTransforms.reserve(scene.objects.size());
+
+    for (std::size_t i{0}; i < m_VisibleObjects.size();) {
+      const Object3D& first{scene.objects[m_VisibleObjects[i]]};
+      const Mesh& mesh{first.GetMesh(first.GetLod())};
+
+      m_InstanceTransforms.clear();
 
-    CalculateTriNormals(processedMesh);
+      for (; i < m_VisibleObjects.size(); ++i) {
+        const Object3D& object3D{scene.objects[m_VisibleObjects[i]]};
 
-    HandleBackfaceCulling(processedMesh, scene.camera);
-    HandleFlatShading(processedMesh, scene.directionalLight);
-    HandleViewSpace(processedMesh);
-    HandleProjection(processedMesh);
-    HandleScreenMapping(processedMesh);
+        if (&object3D.GetMesh(object3D.GetLod()) != &mesh) {
+          break;
+        }
 
-    return processedMesh;
+        m_InstanceTransforms.push_back(&object3D.GetTransform());
+      }
+
+      HandleInstances(mesh, m_InstanceTransforms, scene.camera, m_ProcessedMesh, vertexOffset, useStreams);
+    }
+
+    HandleFlatShading(m_ProcessedMesh, scene.directionalLight);
+
+    return m_ProcessedMesh;
   }
 
   void GeometryProcessing::CalculateViewMatrix(Camera& camera) {
@@ -65,61 +169,263 @@ namespace engine {
     camera.ClearProjectionDirty();
   }
 
-  // Calculate the normal vector of the triangles of the mesh taking advantage 
-  // of the clock-wise order of the vertices. The vertices are first translated
-  // so that adjacent lines originate at (0, 0, 0), then their cross product
-  // is calculated
-  void GeometryProcessing::CalculateTriNormals(Mesh& processedMesh) const {
-    const auto& vertexBuffer{processedMesh.vertexBuffer};
-    const auto& indexBuffer{processedMesh.indexBuffer};
-    auto& triNormals{processedMesh.triNormals};
+  // Concatenates the model, view, projection and screen mapping matrices.
+  // The view and projection matrices are meant to be used as Vector3 * Matrix4x4,
+  // so they are transposed to follow the Matrix4x4 * Vector3 convention of the 
+  // model matrix. The screen mapping is necessary as the engine uses a normalized
+  // screen space, where both axes have values within the range [-1,1]. Since it
+  // is applied after the division by w, it is folded in as a viewport matrix
+  Matrix4x4 GeometryProcessing::CalculateVertexMatrix(const Transform& transform) const {
+    const float halfWidth{0.5f * static_cast<float>(m_Screen.GetWidth())};
+    const float halfHeight{0.5f * static_cast<float>(m_Screen.GetHeight())};
+
+    Matrix4x4 viewportMat{};
+    viewportMat.matrix[0][0] = halfWidth;
+    viewportMat.matrix[0][3] = halfWidth;
+    viewportMat.matrix[1][1] = halfHeight;
+    viewportMat.matrix[1][3] = halfHeight;
+    viewportMat.matrix[2][2] = 1.0f;
+    viewportMat.matrix[3][3] = 1.0f;
+
+    return viewportMat * m_ProjectionMat.GetTransposed() * m_ViewMat.GetTransposed() * transform.GetModelMatrix();
+  }
 
-    triNormals.resize(indexBuffer.size());
+  // Maps world space points into clip space (see Frustum)
+  Matrix4x4 GeometryProcessing::CalculateViewProjectionMatrix() const {
+    return m_ProjectionMat.GetTransposed() * m_ViewMat.GetTransposed();
+  }
+
+  // The vertex matrix maps the points into screen space once divided by w,
+  // so the planes of the guard band are x >= -g, x <= width + g (and the
+  // same for y) multiplied by w. The near plane is z >= 0, as in clip space.
+  // Inside the guard band the rasterizer can handle the triangles on its own,
+  // by clamping their bounding box, while the size of the coordinates stays
+  // small enough for the edge functions to be precise
+  void GeometryProcessing::CalculateClipPlanes() {
+    const float width{static_cast<float>(m_Screen.GetWidth())};
+    const float height{static_cast<float>(m_Screen.GetHeight())};
+
+    m_ClipPlanes = {
+      ClipPlane{0.0f, 0.0f, 1.0f, 0.0f},
+      ClipPlane{1.0f, 0.0f, 0.0f, g_GuardBand},
+      ClipPlane{-1.0f, 0.0f, 0.0f, width + g_GuardBand},
+      ClipPlane{0.0f, 1.0f, 0.0f, g_GuardBand},
+      ClipPlane{0.0f, -1.0f, 0.0f, height + g_GuardBand}
+    };
+  }
+
+  // Each clip plane is brought into object space through the rows of the
+  // vertex matrix, then the corner of the box that is furthest against its
+  // normal is tested
+  bool GeometryProcessing::IsInsideClipVolume(const Aabb& aabb, const Matrix4x4& vertexMat) const {
+    const auto& m{vertexMat.matrix};
 
-    for (std::size_t i{0}; i < indexBuffer.size(); ++i) {
-      const auto& triIndices{indexBuffer[i]};
+    for (const ClipPlane& plane : m_ClipPlanes) {
+      float coefficients[4];
 
-      std::array<Vector3, 2> edges {
-        Vector3{vertexBuffer[triIndices[1]].position - vertexBuffer[triIndices[0]].position},
-        Vector3{vertexBuffer[triIndices[2]].position - vertexBuffer[triIndices[0]].position}
+      for (std::size_t col{0}; col < 4; ++col) {
+        coefficients[col] = plane.a * m[0][col] + plane.b * m[1][col] + plane.c * m[2][col] + plane.d * m[3][col];
+      }
+
+      const Vector3 corner{
+        coefficients[0] >= 0.0f ? aabb.min.x : aabb.max.x,
+        coefficients[1] >= 0.0f ? aabb.min.y : aabb.max.y,
+        coefficients[2] >= 0.0f ? aabb.min.z : aabb.max.z
       };
 
-      triNormals[i] = Math::CrossProduct(edges[0], edges[1]);
+      if (coefficients[0] * corner.x + coefficients[1] * corner.y + coefficients[2] * corner.z + coefficients[3] < 0.0f) {
+        return false;
+      }
     }
+
+    return true;
   }
 
-  void GeometryProcessing::HandleBackfaceCulling(Mesh& processedMesh, const Camera& camera) const {
-    const auto& vertexBuffer{processedMesh.vertexBuffer};
-    const auto& indexBuffer{processedMesh.indexBuffer};
-    const auto& triNormals{processedMesh.triNormals};
+  // The BVH of the scene gives the objects whose world space box is not
+  // outside of the frustum. They are checked again with their tighter object
+  // space box, against the frustum planes brought into their object space.
+  // The indices are sorted so that the objects are always drawn in the order
+  // of the scene
+  void GeometryProcessing::HandleFrustumCulling(Scene& scene, std::vector<std::size_t>& visibleObjects) const {
+    ScopedTimer timer{ProfilerStage::FrustumCulling};
+
+    const Matrix4x4 viewProjectionMat{CalculateViewProjectionMatrix()};
+
+    scene.bvh.Update(scene.objects);
+
+    visibleObjects.clear();
+    visibleObjects.reserve(scene.objects.size());
+
+    scene.bvh.CullFrustum(Frustum{viewProjectionMat}, visibleObjects);
+
+    std::sort(visibleObjects.begin(), visibleObjects.end());
 
-    std::vector<std::array<std::size_t, 3>> newIndexBuffer;
-    newIndexBuffer.reserve(indexBuffer.size());
+    auto isOutside = [&](std::size_t objectIndex) {
+      const Object3D& object3D{scene.objects[objectIndex]};
+      return Frustum{viewProjectionMat * object3D.GetTransform().GetModelMatrix()}.IsOutside(object3D.GetMesh().aabb);
+    };
 
-    std::vector<Vector3> newTriNormals;
-    newTriNormals.reserve(triNormals.size());
+    visibleObjects.erase(std::remove_if(visibleObjects.begin(), visibleObjects.end(), isOutside), visibleObjects.end());
+  }
+
+  // The error of a level, in object space, is projected at the point of the
+  // bounding sphere closest to the camera: the selected level is the coarsest
+  // one whose error stays below g_LodPixelError on the render resolution.
+  // The scale of the model matrix is taken at its largest, so the projected
+  // error is never underestimated
+  void GeometryProcessing::HandleLodSelection(Scene& scene, const std::vector<std::size_t>& visibleObjects) const {
+    const Vector3& cameraPosition{scene.camera.GetTransform().GetPosition()};
+    const float pixelsPerUnit{m_ProjectionMat.matrix[1][1] * 0.5f * static_cast<float>(m_Screen.GetHeight())};
 
-    for (std::size_t i{0}; i < indexBuffer.size(); ++i) {
-      const auto& triIndices{indexBuffer[i]};
+    for (std::size_t objectIndex : visibleObjects) {
+      Object3D& object3D{scene.objects[objectIndex]};
+
+      if (object3D.GetLodCount() == 1) {
+        continue;
+      }
 
-      // The ray goes from the camera to a point of the current triangle
-      Vector3 cameraRay{vertexBuffer[triIndices[0]].position - camera.GetTransform().GetPosition()};
+      const Transform& transform{object3D.GetTransform()};
+      const Vector3& scale{transform.GetScale()};
+      const float maxScale{std::max({std::abs(scale.x), std::abs(scale.y), std::abs(scale.z)})};
 
-      // Checks if the triangle is facing the camera. If the vectors are aligned,
-      // then the triangle should be visible
-      bool isTriFrontFaced{Math::DotProduct(triNormals[i], cameraRay) < 0.0f};
+      const BoundingSphere sphere{object3D.GetMesh().boundingSphere.GetTransformed(transform.GetModelMatrix())};
+      const float distance{std::max((sphere.center - cameraPosition).GetModule() - sphere.radius, scene.camera.GetZNear())};
+      const float errorToPixels{maxScale * pixelsPerUnit / distance};
+
+      std::size_t lod{object3D.GetLod()};
+
+      while (lod > 0 && object3D.GetLodError(lod) * errorToPixels > g_LodPixelError) {
+        --lod;
+      }
 
-      if (isTriFrontFaced) {
-        newIndexBuffer.push_back(indexBuffer[i]);
-        newTriNormals.push_back(triNormals[i]);
+      while (lod + 1 < object3D.GetLodCount() && object3D.GetLodError(lod + 1) * errorToPixels < g_LodPixelError * k_LodHysteresis) {
+        ++lod;
       }
+
+      object3D.SetLod(lod);
     }
+  }
+
+  // Processes the mesh once per transform, appending each instance after the
+  // previous one. vertexOffset is advanced past the vertices of every instance
+  void GeometryProcessing::HandleInstances(
+    const Mesh& mesh, const std::vector<const Transform*>& transforms, const Camera& camera, 
+    Mesh& processedMesh, std::size_t& vertexOffset, bool useStreams
+  ) {
+    for (const Transform* transform : transforms) {
+      const std::size_t triOffset{processedMesh.indexBuffer.GetSize()};
+      const Matrix4x4 vertexMat{CalculateVertexMatrix(*transform)};
+
+      HandleBackfaceCulling(mesh, *transform, camera, processedMesh, vertexOffset);
+
+      if (IsInsideClipVolume(mesh.aabb, vertexMat)) {
+        HandleVertexProcessing(mesh, vertexMat, processedMesh, vertexOffset, useStreams);
+      }
+      else {
+        HandleClipping(mesh, vertexMat, processedMesh, vertexOffset, triOffset, useStreams);
+      }
 
-    processedMesh.indexBuffer = std::move(newIndexBuffer);
-    processedMesh.triNormals = std::move(newTriNormals);
+      // Clipping may have added vertices after the ones of the mesh
+      vertexOffset = useStreams ? processedMesh.vertexStreams.GetSize() : processedMesh.vertexBuffer.size();
+    }
+  }
+
+  // A triangle is visible when its world space normal points against the ray
+  // going from the camera to one of its vertices. Given the linear part A and 
+  // the translation t of the model matrix, the world space normal is cof(A) * n,
+  // where n is the object space normal and cof(A) the cofactor matrix of A, so:
+  //   dot(cof(A) * n, A * p + t - cameraPosition) = det(A) * dot(n, p) + dot(n, k)
+  // with k = cof(A)^T * (t - cameraPosition). dot(n, p) is precomputed by the
+  // Mesh, so each triangle costs a single dot product. The world space normal
+  // is then computed only for the visible triangles, as flat shading needs it.
+  // The same expression is det(A) * dot(n, p - c), where c = -k / det(A) is the
+  // camera in object space, so the meshlets of the mesh are culled in object
+  // space too: a meshlet faces away when its normal cone, seen from c, is
+  // entirely behind its bounding sphere, and it is out of view when its
+  // sphere is outside of the object space frustum
+  void GeometryProcessing::HandleBackfaceCulling(
+    const Mesh& mesh, const Transform& transform, const Camera& camera, Mesh& processedMesh, std::size_t vertexOffset
+  ) const {
+    ScopedTimer timer{ProfilerStage::BackfaceCulling};
+    const auto& triNormals{mesh.triNormals};
+    const auto& triOffsets{mesh.triOffsets};
+
+    const auto& m{transform.GetModelMatrix().matrix};
+
+    // Columns of the linear part of the model matrix
+    const Vector3 a0{m[0][0], m[1][0], m[2][0]};
+    const Vector3 a1{m[0][1], m[1][1], m[2][1]};
+    const Vector3 a2{m[0][2], m[1][2], m[2][2]};
+
+    // Columns of cof(A)
+    const Vector3 c0{Math::CrossProduct(a1, a2)};
+    const Vector3 c1{Math::CrossProduct(a2, a0)};
+    const Vector3 c2{Math::CrossProduct(a0, a1)};
+
+    const float det{Math::DotProduct(a0, c0)};
+    const Vector3 translationToCamera{Vector3{m[0][3], m[1][3], m[2][3]} - camera.GetTransform().GetPosition()};
+    const Vector3 k{
+      Math::DotProduct(c0, translationToCamera),
+      Math::DotProduct(c1, translationToCamera),
+      Math::DotProduct(c2, translationToCamera)
+    };
+
+    auto& newIndexBuffer{processedMesh.indexBuffer.GetTris<std::uint32_t>()};
+    auto& newTriNormals{processedMesh.triNormals};
+    const auto offset{static_cast<std::uint32_t>(vertexOffset)};
+
+    // The meshlets need a camera position, so they are ignored for a singular matrix
+    const bool useMeshlets{!mesh.meshlets.empty() && det != 0.0f};
+    const Vector3 objectCameraPosition{useMeshlets ? k * (-1.0f / det) : Vector3{}};
+    const float coneSign{det > 0.0f ? 1.0f : -1.0f};
+
+    Frustum objectFrustum{CalculateViewProjectionMatrix() * transform.GetModelMatrix()};
+    objectFrustum.Normalize();
+    const bool isFullyVisible{!useMeshlets || objectFrustum.Contains(mesh.aabb)};
+
+    mesh.indexBuffer.Visit([&](const auto& indexBuffer) {
+      auto cullTris = [&](std::size_t triBegin, std::size_t triEnd) {
+        for (std::size_t i{triBegin}; i < triEnd; ++i) {
+          const Vector3& n{triNormals[i]};
+
+          // Checks if the triangle is facing the camera. If the vectors are aligned,
+          // then the triangle should be visible
+          bool isTriFrontFaced{det * triOffsets[i] + Math::DotProduct(n, k) < 0.0f};
+
+          if (isTriFrontFaced) {
+            const auto& triIndices{indexBuffer[i]};
+
+            newIndexBuffer.push_back({triIndices[0] + offset, triIndices[1] + offset, triIndices[2] + offset});
+            newTriNormals.push_back(c0 * n.x + c1 * n.y + c2 * n.z);
+          }
+        }
+      };
+
+      if (!useMeshlets) {
+        cullTris(0, indexBuffer.size());
+        return;
+      }
+
+      for (const Meshlet& meshlet : mesh.meshlets) {
+        const BoundingSphere& sphere{meshlet.boundingSphere};
+        const Vector3 toMeshlet{sphere.center - objectCameraPosition};
+
+        bool isBackFaced{
+          coneSign * Math::DotProduct(toMeshlet, meshlet.coneAxis) >= meshlet.coneCutoff * toMeshlet.GetModule() + sphere.radius
+        };
+
+        if (isBackFaced || (!isFullyVisible && objectFrustum.IsOutside(sphere))) {
+          continue;
+        }
+
+        cullTris(meshlet.triOffset, meshlet.triOffset + meshlet.triCount);
+      }
+    });
   }
 
   void GeometryProcessing::HandleFlatShading(Mesh& processedMesh, const DirectionalLight& directionalLight) const {
+    ScopedTimer timer{ProfilerStage::FlatShading};
+
     const auto& triNormals{processedMesh.triNormals};
     auto& triBrightness{processedMesh.triBrightness};
         
@@ -138,35 +444,178 @@ namespace engine {
     }
   }
 
-  // Converts world space coordinates into view space coordinates
-  void GeometryProcessing::HandleViewSpace(Mesh& processedMesh) const {
-    auto& vertexBuffer{processedMesh.vertexBuffer};
+  // Transforms every vertex from object space to screen space with the
+  // concatenated matrix. With useStreams the positions are written into the
+  // SoA streams of the processed mesh, otherwise into its vertexBuffer
+  void GeometryProcessing::HandleVertexProcessing(
+    const Mesh& mesh, const Matrix4x4& vertexMat, Mesh& processedMesh, std::size_t vertexOffset, bool useStreams
+  ) const {
+    ScopedTimer timer{ProfilerStage::VertexProcessing};
+
+    if (useStreams) {
+      const auto& streams{mesh.vertexStreams};
+      auto& processedStreams{processedMesh.vertexStreams};
+
+      processedStreams.Resize(vertexOffset + streams.GetSize());
 
-    for (auto& v : vertexBuffer) {
-      v.position = v.position * m_ViewMat;  // WARNING: it may be necessary to do the same to the normals
+      TransformKernel::TransformPoints(vertexMat, StreamTransformData{
+        streams.px.data(), streams.py.data(), streams.pz.data(),
+        processedStreams.px.data() + vertexOffset, processedStreams.py.data() + vertexOffset, processedStreams.pz.data() + vertexOffset,
+        streams.GetSize()
+      });
+
+      return;
     }
-  }
 
-  // Projects the mesh to the screen multiplying it by the projection matrix
-  void GeometryProcessing::HandleProjection(Mesh& processedMesh) const {
-    auto& vertexBuffer{processedMesh.vertexBuffer};
+    const auto& vertexBuffer{mesh.vertexBuffer};
+    auto& processedVertexBuffer{processedMesh.vertexBuffer};
 
-    for (auto& v : vertexBuffer) {
-      v.position = v.position * m_ProjectionMat;
+    processedVertexBuffer.resize(vertexOffset + vertexBuffer.size());
+
+    for (std::size_t i{0}; i < vertexBuffer.size(); ++i) {
+      processedVertexBuffer[vertexOffset + i].position = vertexMat * vertexBuffer[i].position;
     }
   }
 
-  // This function is necessary as the engine uses a normalized
-  // screen space, where both axes have values within the range [-1,1]. 
-  // Therefore, the vertices of each triangle in a mesh must be scaled
-  // accordingly before rendering
-  void GeometryProcessing::HandleScreenMapping(Mesh& processedMesh) const {
-    auto& vertexBuffer{processedMesh.vertexBuffer};
+  // The vertices of the object are transformed without the division by w.
+  // Those inside every clip plane are written to the processed mesh like in
+  // HandleVertexProcessing(). Each triangle is then clipped as a polygon,
+  // one plane at a time (Sutherland-Hodgman), which keeps its winding order:
+  // the vertices created on the planes are appended to the processed mesh,
+  // and the polygon is split back into triangles as a fan
+  void GeometryProcessing::HandleClipping(
+    const Mesh& mesh, const Matrix4x4& vertexMat, Mesh& processedMesh, std::size_t vertexOffset, std::size_t triOffset, bool useStreams
+  ) {
+    ScopedTimer timer{ProfilerStage::Clipping};
+
+    const auto& m{vertexMat.matrix};
+    const auto& vertexBuffer{mesh.vertexBuffer};
+
+    std::size_t vertexCount{vertexOffset + vertexBuffer.size()};
+
+    auto resizePositions = [&](std::size_t size) {
+      if (useStreams) {
+        processedMesh.vertexStreams.Resize(size);
+      }
+      else {
+        processedMesh.vertexBuffer.resize(size);
+      }
+    };
+
+    auto setPosition = [&](std::size_t index, const ClipVertex& v) {
+      const Vector3 position{Vector3{v.x, v.y, v.z} / v.w};
+
+      if (useStreams) {
+        processedMesh.vertexStreams.px[index] = position.x;
+        processedMesh.vertexStreams.py[index] = position.y;
+        processedMesh.vertexStreams.pz[index] = position.z;
+      }
+      else {
+        processedMesh.vertexBuffer[index].position = position;
+      }
+    };
+
+    auto isInside = [&](const ClipVertex& v) {
+      return std::all_of(m_ClipPlanes.begin(), m_ClipPlanes.end(), [&](const ClipPlane& plane) {
+        return GetClipDistance(plane, v) >= 0.0f;
+      });
+    };
+
+    resizePositions(vertexCount);
+    m_ClipVertices.resize(vertexBuffer.size());
 
-    for (auto& v : vertexBuffer) {
-      v.position.x = (v.position.x + 1.0f) * 0.5f * static_cast<float>(m_Screen.GetWidth());
-      v.position.y = (v.position.y + 1.0f) * 0.5f * static_cast<float>(m_Screen.GetHeight());
+    for (std::size_t i{0}; i < vertexBuffer.size(); ++i) {
+      const Vector3& p{vertexBuffer[i].position};
+      ClipVertex& v{m_ClipVertices[i]};
+
+      v.x = m[0][0] * p.x + m[0][1] * p.y + m[0][2] * p.z + m[0][3];
+      v.y = m[1][0] * p.x + m[1][1] * p.y + m[1][2] * p.z + m[1][3];
+      v.z = m[2][0] * p.x + m[2][1] * p.y + m[2][2] * p.z + m[2][3];
+      v.w = m[3][0] * p.x + m[3][1] * p.y + m[3][2] * p.z + m[3][3];
+
+      // The vertices outside are never referenced by the clipped triangles
+      if (isInside(v)) {
+        setPosition(vertexOffset + i, v);
+      }
     }
+
+    auto& indexBuffer{processedMesh.indexBuffer.GetTris<std::uint32_t>()};
+    auto& triNormals{processedMesh.triNormals};
+
+    m_ClippedTris.clear();
+    m_ClippedTriNormals.clear();
+
+    for (std::size_t i{triOffset}; i < indexBuffer.size(); ++i) {
+      PolygonVertex polygon[k_MaxClipPolygonSize];
+      PolygonVertex clippedPolygon[k_MaxClipPolygonSize];
+      std::size_t polygonSize{3};
+
+      for (std::size_t k{0}; k < 3; ++k) {
+        polygon[k] = PolygonVertex{m_ClipVertices[indexBuffer[i][k] - vertexOffset], indexBuffer[i][k]};
+      }
+
+      for (const ClipPlane& plane : m_ClipPlanes) {
+        std::size_t clippedSize{0};
+
+        for (std::size_t k{0}; k < polygonSize; ++k) {
+          const PolygonVertex& current{polygon[k]};
+          const PolygonVertex& next{polygon[(k + 1) % polygonSize]};
+
+          const float currentDistance{GetClipDistance(plane, current.position)};
+          const float nextDistance{GetClipDistance(plane, next.position)};
+
+          if (currentDistance >= 0.0f) {
+            clippedPolygon[clippedSize++] = current;
+          }
+
+          // The edge crosses the plane
+          if ((currentDistance >= 0.0f) != (nextDistance >= 0.0f)) {
+            const float t{currentDistance / (currentDistance - nextDistance)};
+            clippedPolygon[clippedSize++] = PolygonVertex{InterpolateClipVertex(current.position, next.position, t), k_NewVertex};
+          }
+        }
+
+        std::swap(polygon, clippedPolygon);
+        polygonSize = clippedSize;
+
+        if (polygonSize < 3) {
+          break;
+        }
+      }
+
+      if (polygonSize < 3) {
+        continue;
+      }
+
+      // The positions are resized once per polygon, within the reserved capacity
+      const std::size_t newVertexCount{static_cast<std::size_t>(std::count_if(
+        polygon, polygon + polygonSize, [](const PolygonVertex& vertex) { return vertex.index == k_NewVertex; }
+      ))};
+
+      if (newVertexCount > 0) {
+        resizePositions(vertexCount + newVertexCount);
+      }
+
+      for (std::size_t k{0}; k < polygonSize; ++k) {
+        if (polygon[k].index == k_NewVertex) {
+          polygon[k].index = vertexCount++;
+          setPosition(polygon[k].index, polygon[k].position);
+        }
+      }
+
+      for (std::size_t k{1}; k + 1 < polygonSize; ++k) {
+        m_ClippedTris.push_back({
+          static_cast<std::uint32_t>(polygon[0].index), static_cast<std::uint32_t>(polygon[k].index), static_cast<std::uint32_t>(polygon[k + 1].index)
+        });
+        m_ClippedTriNormals.push_back(triNormals[i]);
+      }
+    }
+
+    indexBuffer.resize(triOffset);
+    indexBuffer.insert(indexBuffer.end(), m_ClippedTris.begin(), m_ClippedTris.end());
+
+    triNormals.resize(triOffset);
+    triNormals.insert(triNormals.end(), m_ClippedTriNormals.begin(), m_ClippedTriNormals.end());
   }
-  
+
 }
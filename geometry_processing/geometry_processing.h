@@ -4,33 +4,98 @@
 #include "entity/camera/camera.h"
 #include "entity/component/mesh/mesh.h"
 #include "entity/light/directional_light.h"
+#include "entity/object3d/object3d.h"
+#include "geometry/frustum.h"
 #include "geometry/primitive.h"
 #include "scene/scene.h"
 #include "screen/screen.h"
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// The vertices are processed in a single pass: the model, view, projection
+// and screen mapping matrices are concatenated once per object, so each
+// vertex is transformed and divided by w exactly once. Backface culling and
+// flat shading work per triangle from the object space data precomputed by
+// the Mesh, so no world space copy of the vertices is needed.
+// The objects outside of the camera frustum are skipped, through the BVH of
+// the scene, before any of their vertices is touched, and the visible ones
+// are appended to a single processed mesh, their indices being offset by the
+// vertices of the previous ones (so the processed mesh always has 32-bit
+// indices, while the meshes are read with their own index type).
+// Each visible object is drawn with the coarsest of its levels of detail
+// whose error is not visible on screen. Consecutive visible objects sharing
+// the same Mesh are processed as instances of it: the per-triangle and
+// per-vertex data of the mesh is read once per instance while it is still in
+// the cache, and only the matrices change. The objects whose box crosses the
+// near plane or the guard band are clipped triangle by triangle in
+// homogeneous space (before the division by w), the others take the fast
+// path. The processed mesh is kept between frames, so that its buffers
+// retain their capacity and no allocation happens once they are large enough
+
 namespace engine {
+
+  // Vertex transformed by the vertex matrix, before the division by w
+  struct ClipVertex {
+    float x, y, z, w;
+  };
+
+  // Half-space a * x + b * y + c * z + d * w >= 0 of the homogeneous space
+  struct ClipPlane {
+    float a, b, c, d;
+  };
     
   class GeometryProcessing {
   public:
     GeometryProcessing(const Screen& screen);
 
-    Mesh GetProcessedMesh(Scene& scene);
+    // The returned mesh is valid until the next call
+    const Mesh& GetProcessedMesh(Scene& scene);
 
   private:
+    friend class Benchmark;     // Times each phase handler separately
+
     const Screen& m_Screen;
     Matrix4x4 m_ViewMat;        // Used for camera view
     Matrix4x4 m_ProjectionMat;  // Used for perspective projections
+    Mesh m_ProcessedMesh;       // Output of the pipeline, reused every frame
+    std::vector<std::size_t> m_VisibleObjects;    // Indices of the objects that passed the frustum culling
+    std::vector<const Transform*> m_InstanceTransforms;   // Transforms of the instances of the current mesh
+
+    static constexpr std::size_t k_ClipPlaneCount{5};
+    std::array<ClipPlane, k_ClipPlaneCount> m_ClipPlanes;   // Near plane and guard band
+    std::vector<ClipVertex> m_ClipVertices;                 // Vertices of the object being clipped
+    std::vector<IndexTriple<std::uint32_t>> m_ClippedTris;  // Output of the clipping, before it replaces the input
+    std::vector<Vector3> m_ClippedTriNormals;
 
     void CalculateViewMatrix(Camera& camera);
     void CalculateProjectionMatrix(Camera& camera);
-    void CalculateTriNormals(Mesh& processedMesh) const;
+    Matrix4x4 CalculateVertexMatrix(const Transform& transform) const;
+    Matrix4x4 CalculateViewProjectionMatrix() const;
+    void CalculateClipPlanes();
+    bool IsInsideClipVolume(const Aabb& aabb, const Matrix4x4& vertexMat) const;
 
-    // Phase handlers
-    void HandleBackfaceCulling(Mesh& processedMesh, const Camera& camera) const;
+    // Phase handlers. The per-object ones append to processedMesh, whose
+    // vertices from vertexOffset onwards belong to the object
+    void HandleFrustumCulling(Scene& scene, std::vector<std::size_t>& visibleObjects) const;
+    void HandleLodSelection(Scene& scene, const std::vector<std::size_t>& visibleObjects) const;
+    void HandleInstances(
+      const Mesh& mesh, const std::vector<const Transform*>& transforms, const Camera& camera, 
+      Mesh& processedMesh, std::size_t& vertexOffset, bool useStreams
+    );
+    void HandleBackfaceCulling(
+      const Mesh& mesh, const Transform& transform, const Camera& camera, Mesh& processedMesh, std::size_t vertexOffset
+    ) const;
     void HandleFlatShading(Mesh& processedMesh, const DirectionalLight& directionalLight) const;
-    void HandleViewSpace(Mesh& processedMesh) const;
-    void HandleProjection(Mesh& processedMesh) const;
-    void HandleScreenMapping(Mesh& processedMeshPtr) const;
+    void HandleVertexProcessing(
+      const Mesh& mesh, const Matrix4x4& vertexMat, Mesh& processedMesh, std::size_t vertexOffset, bool useStreams
+    ) const;
+    // Replaces the triangles of the object, from triOffset onwards, with their clipped version
+    void HandleClipping(
+      const Mesh& mesh, const Matrix4x4& vertexMat, Mesh& processedMesh, std::size_t vertexOffset, std::size_t triOffset, bool useStreams
+    );
   };
   
 }
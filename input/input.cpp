@@ -0,0 +1,38 @@
+#include "input.h"
+
+#include <sys/select.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace engine {
+
+  bool kbhit() {
+    timeval timeout{0, 0};   // Returns immediately
+
+    fd_set readFds;
+    FD_ZERO(&readFds);
+    FD_SET(STDIN_FILENO, &readFds);
+
+    return select(STDIN_FILENO + 1, &readFds, nullptr, nullptr, &timeout) > 0;
+  }
+
+  char getch() {
+    termios oldAttributes{};
+    tcgetattr(STDIN_FILENO, &oldAttributes);
+
+    // Disables the line buffering and the echo only while reading
+    termios newAttributes{oldAttributes};
+    newAttributes.c_lflag &= ~(ICANON | ECHO);
+    tcsetattr(STDIN_FILENO, TCSANOW, &newAttributes);
+
+    char c{0};
+    if (read(STDIN_FILENO, &c, 1) != 1) {
+      c = 0;
+    }
+
+    tcsetattr(STDIN_FILENO, TCSANOW, &oldAttributes);
+
+    return c;
+  }
+  
+}
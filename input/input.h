@@ -0,0 +1,13 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+// This script provides non-blocking keyboard access on Linux terminals
+
+namespace engine {
+
+  bool kbhit();   // Tells whether a key is waiting to be read from stdin
+  char getch();   // Reads a single key without waiting for the enter key and without echoing it
+  
+}
+
+#endif
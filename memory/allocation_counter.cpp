@@ -0,0 +1,66 @@
+#include "allocation_counter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace engine {
+
+#ifdef ENGINE_COUNT_ALLOCATIONS
+  static std::atomic<std::size_t> s_AllocationCount{0};
+#endif
+
+  bool AllocationCounter::IsEnabled() {
+#ifdef ENGINE_COUNT_ALLOCATIONS
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  std::size_t AllocationCounter::GetCount() {
+#ifdef ENGINE_COUNT_ALLOCATIONS
+    return s_AllocationCount.load(std::memory_order_relaxed);
+#else
+    return 0;
+#endif
+  }
+  
+}
+
+#ifdef ENGINE_COUNT_ALLOCATIONS
+
+// The array and nothrow versions of the default operators call these ones
+void* operator new(std::size_t size) {
+  engine::s_AllocationCount.fetch_add(1, std::memory_order_relaxed);
+
+  if (void* ptr{std::malloc(size == 0 ? 1 : size)}) {
+    return ptr;
+  }
+
+  throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+  engine::s_AllocationCount.fetch_add(1, std::memory_order_relaxed);
+
+  // std::aligned_alloc() requires the size to be a multiple of the alignment
+  std::size_t align{static_cast<std::size_t>(alignment)};
+  std::size_t bytes{(size + align - 1) / align * align};
+
+  if (void* ptr{std::aligned_alloc(align, bytes == 0 ? align : bytes)}) {
+    return ptr;
+  }
+
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept { std::free(ptr); }
+
+#endif
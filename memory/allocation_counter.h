@@ -0,0 +1,24 @@
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+
+#include <cstddef>
+
+// When ENGINE_COUNT_ALLOCATIONS is defined (Debug builds), the global
+// operator new is replaced by a version that counts every heap allocation.
+// The rendering loop uses the counter to check that, once the buffers have
+// reached their final capacity, a frame does not allocate anything
+
+namespace engine {
+
+  class AllocationCounter {
+  public:
+    AllocationCounter() = delete;
+
+    // Getters
+    static bool IsEnabled();
+    static std::size_t GetCount();    // Allocations made since the start of the program
+  };
+  
+}
+
+#endif
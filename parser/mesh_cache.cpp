@@ -0,0 +1,260 @@
+#include "mesh_cache.h"
+
+#include "settings.h"
+
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace engine {
+  // REMEMBER: the following structs and functions are used exclusively inside this file
+
+  // Must be increased every time the layout of the file, of Vertex or of the
+  // index buffer, or the processing of the parsed meshes changes
+  constexpr std::uint32_t k_MeshCacheVersion{3};
+  constexpr char k_MeshCacheMagic[8]{'E', 'N', 'G', 'M', 'E', 'S', 'H', '\0'};
+
+  // Processing applied to the parsed mesh before it was stored
+  constexpr std::uint32_t k_OptimizedVertexCacheFlag{1u << 0};
+
+  struct MeshCacheHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t vertexSize;           // sizeof(Vertex) of the build that wrote the file
+    std::uint32_t indexSize;            // Bytes of each index (2 or 4, see IndexBuffer)
+    std::uint32_t processingFlags;      // See GetProcessingFlags()
+    std::uint64_t sourceSize;           // Bytes
+    std::int64_t sourceModificationTime; // Nanoseconds since the epoch
+    std::uint64_t vertexCount;
+    std::uint64_t triCount;
+  };
+
+  struct SourceStamp {
+    std::uint64_t size;
+    std::int64_t modificationTime;
+  };
+
+  // Keeps a read-only mapping of a whole file alive for the current scope
+  struct MappedFile {
+    int fd{-1};
+    void* data{MAP_FAILED};
+    std::size_t size{0};
+
+    explicit MappedFile(const std::string& path) {
+      fd = open(path.c_str(), O_RDONLY);
+      if (fd < 0) {
+        return;
+      }
+
+      struct stat fileStat;
+      if (fstat(fd, &fileStat) != 0 || fileStat.st_size <= 0) {
+        return;
+      }
+
+      size = static_cast<std::size_t>(fileStat.st_size);
+      data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+
+    ~MappedFile() {
+      if (data != MAP_FAILED) {
+        munmap(data, size);
+      }
+      if (fd >= 0) {
+        close(fd);
+      }
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool IsValid() const { return data != MAP_FAILED; }
+  };
+
+  // The indices are read with the type of the file. Returns false if any of
+  // them is outside of the vertexBuffer (i.e. the file is corrupted)
+  template <typename Index>
+  static bool ReadIndexBuffer(const unsigned char* bytes, std::size_t triCount, std::size_t vertexCount, IndexBuffer& indexBuffer) {
+    std::vector<IndexTriple<Index>> tris(triCount);
+    std::memcpy(tris.data(), bytes, triCount * sizeof(IndexTriple<Index>));
+
+    for (const auto& triIndices : tris) {
+      for (Index index : triIndices) {
+        if (index >= vertexCount) {
+          return false;
+        }
+      }
+    }
+
+    indexBuffer = IndexBuffer{std::move(tris)};
+
+    return true;
+  }
+
+  static bool GetSourceStamp(const std::string& sourcePath, SourceStamp& stamp) {
+    struct stat fileStat;
+    if (stat(sourcePath.c_str(), &fileStat) != 0) {
+      return false;
+    }
+
+    stamp.size = static_cast<std::uint64_t>(fileStat.st_size);
+    stamp.modificationTime = static_cast<std::int64_t>(fileStat.st_mtim.tv_sec) * 1000000000 + fileStat.st_mtim.tv_nsec;
+
+    return true;
+  }
+
+  // write() may stop before the end of the data, so it is called until all of it is written
+  static bool WriteAll(int fd, const void* data, std::size_t size) {
+    const char* bytes{static_cast<const char*>(data)};
+
+    while (size > 0) {
+      const ssize_t written{write(fd, bytes, size)};
+      if (written < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return false;
+      }
+
+      bytes += written;
+      size -= static_cast<std::size_t>(written);
+    }
+
+    return true;
+  }
+
+  // The flags of the processing the current settings apply to the parsed
+  // meshes, as a cache written with different settings holds another order
+  static std::uint32_t GetProcessingFlags() {
+    std::uint32_t processingFlags{0};
+
+    if (g_OptimizeVertexCache) {
+      processingFlags |= k_OptimizedVertexCacheFlag;
+    }
+
+    return processingFlags;
+  }
+
+  std::string MeshCache::GetCachePath(const std::string& sourcePath) {
+    return sourcePath + k_Extension;
+  }
+
+  std::optional<Mesh> MeshCache::Load(const std::string& sourcePath) {
+    SourceStamp stamp;
+    if (!GetSourceStamp(sourcePath, stamp)) {
+      return std::nullopt;
+    }
+
+    MappedFile file{GetCachePath(sourcePath)};
+    if (!file.IsValid() || file.size < sizeof(MeshCacheHeader)) {
+      return std::nullopt;
+    }
+
+    const auto* bytes{static_cast<const unsigned char*>(file.data)};
+
+    MeshCacheHeader header;
+    std::memcpy(&header, bytes, sizeof(MeshCacheHeader));
+
+    bool isCompatible{
+      std::memcmp(header.magic, k_MeshCacheMagic, sizeof(k_MeshCacheMagic)) == 0 &&
+      header.version == k_MeshCacheVersion &&
+      header.vertexSize == sizeof(Vertex) &&
+      header.processingFlags == GetProcessingFlags() &&
+      (header.indexSize == sizeof(std::uint16_t) || header.indexSize == sizeof(std::uint32_t))
+    };
+    bool isFresh{header.sourceSize == stamp.size && header.sourceModificationTime == stamp.modificationTime};
+
+    if (!isCompatible || !isFresh || header.vertexCount == 0 || header.triCount == 0) {
+      return std::nullopt;
+    }
+
+    // The counts are checked against the file size before being used, so a
+    // truncated file is rejected instead of being read out of bounds
+    std::size_t maxCount{file.size / sizeof(Vertex)};
+    if (header.vertexCount > maxCount || header.triCount > maxCount) {
+      return std::nullopt;
+    }
+
+    std::size_t vertexBytes{static_cast<std::size_t>(header.vertexCount) * sizeof(Vertex)};
+    std::size_t indexBytes{static_cast<std::size_t>(header.triCount) * 3 * header.indexSize};
+
+    if (file.size != sizeof(MeshCacheHeader) + vertexBytes + indexBytes) {
+      return std::nullopt;
+    }
+
+    std::vector<Vertex> vertexBuffer(header.vertexCount);
+    std::memcpy(vertexBuffer.data(), bytes + sizeof(MeshCacheHeader), vertexBytes);
+
+    // A corrupted index would make the mesh read outside of the vertexBuffer
+    const unsigned char* indexBytesBegin{bytes + sizeof(MeshCacheHeader) + vertexBytes};
+    const std::size_t triCount{static_cast<std::size_t>(header.triCount)};
+    IndexBuffer indexBuffer;
+
+    bool isValid{
+      header.indexSize == sizeof(std::uint16_t) ? 
+        ReadIndexBuffer<std::uint16_t>(indexBytesBegin, triCount, vertexBuffer.size(), indexBuffer) :
+        ReadIndexBuffer<std::uint32_t>(indexBytesBegin, triCount, vertexBuffer.size(), indexBuffer)
+    };
+
+    if (!isValid) {
+      return std::nullopt;
+    }
+
+    return Mesh{std::move(vertexBuffer), std::move(indexBuffer)};
+  }
+
+  // The file is written under a unique temporary name and then renamed, so
+  // that a concurrent or interrupted run never sees a partially written cache
+  bool MeshCache::Store(const std::string& sourcePath, const Mesh& mesh) {
+    SourceStamp stamp;
+    if (!GetSourceStamp(sourcePath, stamp)) {
+      return false;
+    }
+
+    MeshCacheHeader header{};
+    std::memcpy(header.magic, k_MeshCacheMagic, sizeof(k_MeshCacheMagic));
+    header.version = k_MeshCacheVersion;
+    header.vertexSize = sizeof(Vertex);
+    header.indexSize = mesh.indexBuffer.GetType() == IndexType::UInt16 ? sizeof(std::uint16_t) : sizeof(std::uint32_t);
+    header.processingFlags = GetProcessingFlags();
+    header.sourceSize = stamp.size;
+    header.sourceModificationTime = stamp.modificationTime;
+    header.vertexCount = mesh.vertexBuffer.size();
+    header.triCount = mesh.indexBuffer.GetSize();
+
+    const std::string cachePath{GetCachePath(sourcePath)};
+    // Created in the same directory as the cache, so the rename cannot cross file systems
+    std::string tempPath{cachePath + ".XXXXXX"};
+
+    const int fd{mkstemp(tempPath.data())};
+    if (fd < 0) {
+      return false;
+    }
+
+    // mkstemp() only gives access to the owner, the cache is as readable as a regular file
+    bool isWritten{fchmod(fd, 0644) == 0};
+    isWritten = isWritten && WriteAll(fd, &header, sizeof(MeshCacheHeader));
+    isWritten = isWritten && WriteAll(fd, mesh.vertexBuffer.data(), mesh.vertexBuffer.size() * sizeof(Vertex));
+    mesh.indexBuffer.Visit([&](const auto& tris) {
+      isWritten = isWritten && WriteAll(fd, tris.data(), mesh.indexBuffer.GetByteSize());
+    });
+    isWritten = close(fd) == 0 && isWritten;
+
+    if (!isWritten || std::rename(tempPath.c_str(), cachePath.c_str()) != 0) {
+      unlink(tempPath.c_str());
+      return false;
+    }
+
+    return true;
+  }
+
+}
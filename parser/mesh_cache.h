@@ -0,0 +1,38 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include "entity/component/mesh/mesh.h"
+
+#include <optional>
+#include <string>
+
+// Binary copy of a parsed mesh, stored next to its source file (same path
+// with the k_Extension suffix). The file contains a header followed by the
+// vertexBuffer and the indexBuffer exactly as they are laid out in memory
+// (the indices keep their 16-bit or 32-bit type, see IndexBuffer),
+// so loading it is a memory mapping plus two copies, without any parsing.
+// The header stores the size and the modification time of the source file:
+// when they do not match anymore the cache is considered stale and ignored.
+// It also records the processing applied after the parsing (e.g. the vertex
+// cache optimization), so a cache written with other settings is ignored too
+
+namespace engine {
+
+  class MeshCache {
+  public:
+    MeshCache() = delete;
+
+    static constexpr const char* k_Extension{".meshcache"};
+
+    static std::string GetCachePath(const std::string& sourcePath);
+
+    // Returns nothing if the cache is missing, stale or written by an incompatible build
+    static std::optional<Mesh> Load(const std::string& sourcePath);
+
+    // Returns false if the cache could not be written (e.g. read-only directory)
+    static bool Store(const std::string& sourcePath, const Mesh& mesh);
+  };
+
+}
+
+#endif
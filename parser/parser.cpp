@@ -1,21 +1,39 @@
 #include "parser.h"
 
+#include "entity/component/mesh/mesh_optimizer.h"
 #include "geometry/primitive.h"
+#include "parser/mesh_cache.h"
+#include "settings.h"
+#include "thread_pool/thread_pool.h"
 
+#include <algorithm>
 #include <array>
+#include <charconv>
+#include <cstring>
 #include <fstream>
-#include <sstream>
+#include <limits>
+#include <optional>
 #include <stdexcept>
+#include <string_view>
+#include <thread>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
-// TO-DO: improve the checks made in the f section
-
 // The main logic is to save each vertex without duplicates. A vertex is identified
-// by its position and its normal. That's the reason why the unordered_map is used
+// by its position and its normal. That's the reason why the unordered_map is used.
+// The whole file is read into a single buffer which is scanned in place: numbers
+// are converted with std::from_chars, so no stream or string is created per line.
+// Faces can reference their vertices as v, v/vt, v/vt/vn or v//vn, with positive
+// or negative (relative) indices, and polygons are triangulated as a fan.
+// Texture coordinates are skipped, as the Vertex has no field for them.
+// Large files are parsed in parallel: see ParseObjFile()
 
 namespace engine {
-  // REMEMBER: the following structs are used exclusively inside this file
+  // REMEMBER: the following structs and functions are used exclusively inside this file
+
+  // Used as the normal index of the vertices that do not reference a normal
+  constexpr std::size_t k_NoIndex{std::numeric_limits<std::size_t>::max()};
 
   // Defines a key for an unordered_map
   struct VertexKey {
@@ -33,82 +51,493 @@ namespace engine {
     }
   };
 
-  // Retrieve a mesh from the input path
-  Mesh Parser::LoadMeshFromFile(const std::string& filePath) {
-    std::ifstream fStream(filePath);
+  // Position of the scanner inside the line being parsed
+  struct LineCursor {
+    const char* ptr;
+    const char* end;    // End of the line (excluded)
+  };
+
+  static bool IsBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+  }
+
+  static void SkipBlanks(LineCursor& cursor) {
+    while (cursor.ptr < cursor.end && IsBlank(*cursor.ptr)) {
+      ++cursor.ptr;
+    }
+  }
+
+  static std::string_view ReadKeyword(LineCursor& cursor) {
+    SkipBlanks(cursor);
+
+    const char* begin{cursor.ptr};
+    while (cursor.ptr < cursor.end && !IsBlank(*cursor.ptr)) {
+      ++cursor.ptr;
+    }
+
+    return std::string_view{begin, static_cast<std::size_t>(cursor.ptr - begin)};
+  }
+
+  static bool ReadFloat(LineCursor& cursor, float& value) {
+    SkipBlanks(cursor);
+
+    // std::from_chars() does not accept the plus sign
+    if (cursor.ptr < cursor.end && *cursor.ptr == '+') {
+      ++cursor.ptr;
+    }
+
+    auto [ptr, ec] = std::from_chars(cursor.ptr, cursor.end, value);
+    if (ec != std::errc{}) {
+      return false;
+    }
+
+    cursor.ptr = ptr;
+    return true;
+  }
+
+  static Vector3 ReadVector3(LineCursor& cursor, const char* errorMessage) {
+    float x, y, z;
+    if (!ReadFloat(cursor, x) || !ReadFloat(cursor, y) || !ReadFloat(cursor, z)) {
+      throw std::invalid_argument(errorMessage);
+    }
+
+    return Vector3{x, y, z};
+  }
+
+  // Converts a 1-based (or negative, relative to the end) OBJ index into a
+  // 0-based index, checking that it refers to an element defined before it
+  static std::size_t ReadIndex(LineCursor& cursor, std::size_t elementCount) {
+    long long index;
+
+    auto [ptr, ec] = std::from_chars(cursor.ptr, cursor.end, index);
+    if (ec != std::errc{}) {
+      throw std::invalid_argument("EXCEPTION: invalid face line format");
+    }
+    cursor.ptr = ptr;
+
+    long long count{static_cast<long long>(elementCount)};
+    if (index > 0 && index <= count) {
+      return static_cast<std::size_t>(index - 1);
+    }
+    if (index < 0 && -index <= count) {
+      return static_cast<std::size_t>(count + index);
+    }
+
+    throw std::invalid_argument("EXCEPTION: face index out of range");
+  }
+
+  // Reads one vertex reference of a face (v, v/vt, v/vt/vn or v//vn)
+  static VertexKey ReadFaceVertex(LineCursor& cursor, std::size_t vCount, std::size_t vtCount, std::size_t vnCount) {
+    VertexKey vKey{ReadIndex(cursor, vCount), k_NoIndex};
+
+    if (cursor.ptr < cursor.end && *cursor.ptr == '/') {
+      ++cursor.ptr;
+
+      // The texture coordinate is optional (v//vn)
+      if (cursor.ptr < cursor.end && *cursor.ptr != '/' && !IsBlank(*cursor.ptr)) {
+        ReadIndex(cursor, vtCount);
+      }
+
+      if (cursor.ptr < cursor.end && *cursor.ptr == '/') {
+        ++cursor.ptr;
+        vKey.vnIndex = ReadIndex(cursor, vnCount);
+      }
+    }
+
+    if (cursor.ptr < cursor.end && !IsBlank(*cursor.ptr)) {
+      throw std::invalid_argument("EXCEPTION: invalid face line format");
+    }
+
+    return vKey;
+  }
+
+  static std::string ReadFile(const std::string& filePath) {
+    std::ifstream fStream(filePath, std::ios::binary | std::ios::ate);
     if (!fStream.is_open()) {
       throw std::invalid_argument("EXCEPTION: unable to open mesh file");
     }
 
-    std::string line;
+    std::string content(static_cast<std::size_t>(fStream.tellg()), '\0');
+    fStream.seekg(0);
+    fStream.read(content.data(), static_cast<std::streamsize>(content.size()));
 
-    std::vector<Vector3> v;                         // Vertices
-    std::vector<Vector3> vn;                        // Vertex normals
+    if (!fStream) {
+      throw std::invalid_argument("EXCEPTION: unable to read mesh file");
+    }
 
-    std::vector<Vertex> vertexBuffer;               // Vertices
-    std::vector<std::array<std::size_t, 3>> indexBuffer; // Triangle indices
+    return content;
+  }
 
-    std::unordered_map<VertexKey, std::size_t, VertexKeyHash> uniqueVertexIndices;
 
-    while (std::getline(fStream, line)) {
-      std::istringstream sStream{line};
-      std::string prefix;
-      sStream >> prefix;
+  // A contiguous range of whole lines of the file, parsed by one task
+  struct ObjChunk {
+    const char* begin;
+    const char* end;
 
-      if (prefix == "v") {
-        float x, y, z;
-        if (!(sStream >> x >> y >> z)) {
-          throw std::invalid_argument("EXCEPTION: invalid vertex line format");
-        }
+    // Elements defined in the chunk (first pass), and defined before it (prefix sums)
+    std::size_t vCount{0}, vnCount{0}, vtCount{0}, triCount{0};
+    std::size_t vBase{0}, vnBase{0}, vtBase{0}, triBase{0};
+
+    std::vector<VertexKey> uniqueKeys;            // Vertices of the chunk, in order of first appearance
+    std::vector<std::size_t> cornerKeys;          // Index in uniqueKeys of each triangle corner
+    std::vector<std::size_t> vertexIndices;       // Index in the final vertexBuffer of each unique key
+    std::vector<std::size_t> shardKeys;           // Index in uniqueKeys of each key, grouped by shard
+    std::vector<std::size_t> shardOffsets;        // Start of the keys of each shard in shardKeys
+    std::size_t ownedCount{0};                    // Unique keys that appear in this chunk first
+    std::size_t vertexBase{0};                    // Owned keys of the previous chunks
+  };
 
-        v.emplace_back(Vector3{x, y, z});
+  // Where a vertex appears for the first time in the file
+  struct KeyOwner {
+    std::size_t chunk, key;
+  };
+
+  using KeyOwnerMap = std::unordered_map<VertexKey, KeyOwner, VertexKeyHash>;
+
+  constexpr std::size_t k_ChunkSize{64 * 1024};   // Smallest chunk worth a task (bytes)
+  constexpr std::size_t k_ChunksPerThread{4};     // More chunks than threads balance the load
+
+  // Splits the text on line boundaries into chunks of about the same size
+  static std::vector<ObjChunk> SplitIntoChunks(const std::string& content, std::size_t threadCount) {
+    // A single thread parses the whole file at once, which skips the merge
+    std::size_t chunkCount{
+      threadCount == 1 ? 1 : std::min(std::max<std::size_t>(content.size() / k_ChunkSize, 1), threadCount * k_ChunksPerThread)
+    };
+
+    const char* end{content.data() + content.size()};
+
+    std::vector<ObjChunk> chunks;
+    chunks.reserve(chunkCount);
+
+    const char* begin{content.data()};
+    for (std::size_t i{1}; i <= chunkCount && begin < end; ++i) {
+      const char* chunkEnd{i == chunkCount ? end : content.data() + content.size() * i / chunkCount};
+
+      if (chunkEnd < begin) {
+        chunkEnd = begin;
       }
-      else if (prefix == "vn") {
-        float x, y, z;
-        if (!(sStream >> x >> y >> z)) {
-          throw std::invalid_argument("EXCEPTION: invalid normal line format");
-        }
+      while (chunkEnd < end && *chunkEnd != '\n') {
+        ++chunkEnd;
+      }
+      if (chunkEnd < end) {
+        ++chunkEnd;
+      }
+
+      ObjChunk chunk;
+      chunk.begin = begin;
+      chunk.end = chunkEnd;
+      chunks.push_back(std::move(chunk));
+
+      begin = chunkEnd;
+    }
+
+    return chunks;
+  }
+
+  // Calls lineHandler(cursor, keyword) for every line of the chunk
+  template <typename LineHandler>
+  static void ForEachLine(const ObjChunk& chunk, LineHandler&& lineHandler) {
+    const char* ptr{chunk.begin};
 
-        vn.emplace_back(Vector3{x, y, z});
+    while (ptr < chunk.end) {
+      const char* lineEnd{static_cast<const char*>(std::memchr(ptr, '\n', static_cast<std::size_t>(chunk.end - ptr)))};
+      if (lineEnd == nullptr) {
+        lineEnd = chunk.end;
       }
-      else if (prefix == "f") {
-        constexpr std::size_t kSize{3};
-        std::array<std::size_t, kSize> triIndices;
 
-        for (std::size_t i{0}; i < kSize; ++i) {
-          std::string token;
-          sStream >> token;
+      LineCursor cursor{ptr, lineEnd};
+      std::string_view keyword{ReadKeyword(cursor)};
+      lineHandler(cursor, keyword);
 
-          std::size_t slashIndex{token.find("//")};
+      ptr = lineEnd + 1;
+    }
+  }
 
-          std::size_t vIndex{std::stoul(token.substr(0, slashIndex)) - 1};
-          std::size_t vnIndex{std::stoul(token.substr(slashIndex + 2)) - 1};
-          VertexKey vKey{vIndex, vnIndex};
+  // First pass: counts the elements, so that every chunk knows how many were
+  // defined before it (needed by the relative indices)
+  static void CountElements(ObjChunk& chunk) {
+    ForEachLine(chunk, [&](LineCursor& cursor, std::string_view keyword) {
+      if (keyword == "v") {
+        ++chunk.vCount;
+      }
+      else if (keyword == "vn") {
+        ++chunk.vnCount;
+      }
+      else if (keyword == "vt") {
+        ++chunk.vtCount;
+      }
+      else if (keyword == "f") {
+        // Fan triangulation: a face with n vertices gives n - 2 triangles
+        std::size_t faceVertexCount{0};
 
-          auto it = uniqueVertexIndices.find(vKey);
-          if (it != uniqueVertexIndices.end()) {
-            triIndices[i] = it->second;
+        SkipBlanks(cursor);
+        while (cursor.ptr < cursor.end) {
+          while (cursor.ptr < cursor.end && !IsBlank(*cursor.ptr)) {
+            ++cursor.ptr;
           }
-          else {
-            vertexBuffer.emplace_back(Vertex{v[vIndex], vn[vnIndex]});
 
-            std::size_t newIndex{static_cast<std::size_t>(vertexBuffer.size() - 1)};
-            uniqueVertexIndices[vKey] = newIndex;
-            triIndices[i] = newIndex;
+          ++faceVertexCount;
+          SkipBlanks(cursor);
+        }
+
+        if (faceVertexCount < 3) {
+          throw std::invalid_argument("EXCEPTION: a face needs at least 3 vertices");
+        }
+
+        chunk.triCount += faceVertexCount - 2;
+      }
+    });
+  }
+
+  // Second pass: writes the positions and the normals into their final place,
+  // and deduplicates the vertices of the faces inside the chunk
+  static void ParseChunk(ObjChunk& chunk, std::vector<Vector3>& v, std::vector<Vector3>& vn) {
+    std::size_t vCount{chunk.vBase};
+    std::size_t vnCount{chunk.vnBase};
+    std::size_t vtCount{chunk.vtBase};
+
+    std::unordered_map<VertexKey, std::size_t, VertexKeyHash> uniqueKeyIndices;
+
+    chunk.cornerKeys.reserve(chunk.triCount * 3);
+
+    // Returns the index of the vertex in uniqueKeys, adding it if it is new
+    auto getKeyIndex = [&](const VertexKey& vKey) {
+      auto [it, isNew] = uniqueKeyIndices.try_emplace(vKey, chunk.uniqueKeys.size());
+      if (isNew) {
+        chunk.uniqueKeys.push_back(vKey);
+      }
+
+      return it->second;
+    };
+
+    ForEachLine(chunk, [&](LineCursor& cursor, std::string_view keyword) {
+      if (keyword == "v") {
+        v[vCount++] = ReadVector3(cursor, "EXCEPTION: invalid vertex line format");
+      }
+      else if (keyword == "vn") {
+        vn[vnCount++] = ReadVector3(cursor, "EXCEPTION: invalid normal line format");
+      }
+      else if (keyword == "vt") {
+        ++vtCount;
+      }
+      else if (keyword == "f") {
+        // Polygons are split into the triangles (0, i - 1, i), which keeps the
+        // winding order of the original face
+        std::size_t faceVertexCount{0};
+        std::size_t firstKey{0};
+        std::size_t previousKey{0};
+
+        SkipBlanks(cursor);
+        while (cursor.ptr < cursor.end) {
+          std::size_t key{getKeyIndex(ReadFaceVertex(cursor, vCount, vtCount, vnCount))};
+
+          if (faceVertexCount == 0) {
+            firstKey = key;
           }
+          else if (faceVertexCount >= 2) {
+            chunk.cornerKeys.insert(chunk.cornerKeys.end(), {firstKey, previousKey, key});
+          }
+
+          previousKey = key;
+          ++faceVertexCount;
+          SkipBlanks(cursor);
+        }
+      }
+    });
+  }
+
+  static std::size_t GetShard(const VertexKey& vKey, std::size_t shardCount) {
+    // The multiplication spreads the bits of the (weak) key hash before the modulo
+    return static_cast<std::size_t>((VertexKeyHash{}(vKey) * 0x9E3779B97F4A7C15ull) >> 32) % shardCount;
+  }
+
+  // Groups the keys of the chunk by shard (counting sort), keeping their order
+  // inside each shard, so that every shard only visits its own keys
+  static void BucketKeysByShard(ObjChunk& chunk, std::size_t shardCount) {
+    std::vector<std::size_t> keyShards(chunk.uniqueKeys.size());
+    chunk.shardOffsets.assign(shardCount + 1, 0);
+
+    for (std::size_t k{0}; k < chunk.uniqueKeys.size(); ++k) {
+      keyShards[k] = GetShard(chunk.uniqueKeys[k], shardCount);
+      ++chunk.shardOffsets[keyShards[k] + 1];
+    }
+
+    for (std::size_t s{0}; s < shardCount; ++s) {
+      chunk.shardOffsets[s + 1] += chunk.shardOffsets[s];
+    }
+
+    std::vector<std::size_t> cursors(chunk.shardOffsets.begin(), chunk.shardOffsets.end() - 1);
+    chunk.shardKeys.resize(chunk.uniqueKeys.size());
+
+    for (std::size_t k{0}; k < chunk.uniqueKeys.size(); ++k) {
+      chunk.shardKeys[cursors[keyShards[k]]++] = k;
+    }
+  }
+
+  Mesh Parser::LoadMeshFromFile(const std::string& filePath) {
+    if (g_UseMeshCache) {
+      if (std::optional<Mesh> cachedMesh{MeshCache::Load(filePath)}) {
+        return std::move(*cachedMesh);
+      }
+    }
+
+    Mesh mesh{ParseObjFile(filePath)};
+
+    // The cache stores the optimized order, so the pass only runs after parsing
+    if (g_OptimizeVertexCache) {
+      MeshOptimizer::OptimizeVertexCache(mesh);
+    }
+
+    if (!g_UseMeshCache) {
+      return mesh;
+    }
+
+    // A cache that cannot be written only costs the parsing at the next launch
+    MeshCache::Store(filePath, mesh);
+
+    return mesh;
+  }
+
+
+  // Retrieve a mesh from the input path. The file is split into chunks which
+  // are parsed in parallel, then the vertices deduplicated by each chunk are
+  // merged. A vertex gets its final index from the first chunk it appears in,
+  // so the buffers are the same, in the same order, for any number of threads
+  Mesh Parser::ParseObjFile(const std::string& filePath) {
+    const std::string content{ReadFile(filePath)};
+
+    std::size_t threadCount{g_ParserThreads == 0 ? std::max(1u, std::thread::hardware_concurrency()) : g_ParserThreads};
+
+    // Small files are not worth starting the threads
+    threadCount = std::min(threadCount, std::max<std::size_t>(content.size() / k_ChunkSize, 1));
+
+    ThreadPool threadPool{threadCount};
+
+    std::vector<ObjChunk> chunks{SplitIntoChunks(content, threadPool.GetThreadCount())};
+
+    threadPool.ParallelFor(chunks.size(), [&](std::size_t i) { CountElements(chunks[i]); });
+
+    // Prefix sums of the counts
+    std::size_t vCount{0}, vnCount{0}, vtCount{0}, triCount{0};
+
+    for (auto& chunk : chunks) {
+      chunk.vBase = vCount;
+      chunk.vnBase = vnCount;
+      chunk.vtBase = vtCount;
+      chunk.triBase = triCount;
+
+      vCount += chunk.vCount;
+      vnCount += chunk.vnCount;
+      vtCount += chunk.vtCount;
+      triCount += chunk.triCount;
+    }
+
+    std::vector<Vector3> v(vCount);                 // Vertices
+    std::vector<Vector3> vn(vnCount);               // Vertex normals
+
+    threadPool.ParallelFor(chunks.size(), [&](std::size_t i) { ParseChunk(chunks[i], v, vn); });
+
+    // Each shard finds the first occurrence of the keys whose hash falls into
+    // it. A single chunk owns all of its keys, so the maps are not needed
+    const std::size_t shardCount{chunks.size() > 1 ? threadPool.GetThreadCount() : 0};
+    std::vector<KeyOwnerMap> shards(shardCount);
+
+    if (shardCount > 0) {
+      threadPool.ParallelFor(chunks.size(), [&](std::size_t c) { BucketKeysByShard(chunks[c], shardCount); });
+    }
+
+    // The chunks are visited in order, so the first chunk to insert a key owns it
+    threadPool.ParallelFor(shardCount, [&](std::size_t s) {
+      for (std::size_t c{0}; c < chunks.size(); ++c) {
+        const auto& chunk{chunks[c]};
+
+        for (std::size_t i{chunk.shardOffsets[s]}; i < chunk.shardOffsets[s + 1]; ++i) {
+          const std::size_t k{chunk.shardKeys[i]};
+          shards[s].try_emplace(chunk.uniqueKeys[k], KeyOwner{c, k});
+        }
+      }
+    });
+
+    // The owned keys of a chunk are numbered in order after the ones of the previous chunks
+    std::vector<std::vector<KeyOwner>> chunkOwners(chunks.size());
+
+    threadPool.ParallelFor(chunks.size(), [&](std::size_t c) {
+      auto& chunk{chunks[c]};
+      auto& owners{chunkOwners[c]};
+      owners.resize(chunk.uniqueKeys.size());
+
+      if (shardCount == 0) {
+        for (std::size_t k{0}; k < chunk.uniqueKeys.size(); ++k) {
+          owners[k] = KeyOwner{c, k};
         }
+      }
+
+      // The keys are already grouped by shard, which saves hashing them again
+      for (std::size_t s{0}; s < shardCount; ++s) {
+        for (std::size_t i{chunk.shardOffsets[s]}; i < chunk.shardOffsets[s + 1]; ++i) {
+          const std::size_t k{chunk.shardKeys[i]};
+          owners[k] = shards[s].at(chunk.uniqueKeys[k]);
+        }
+      }
 
-        indexBuffer.push_back(triIndices);
+      for (std::size_t k{0}; k < chunk.uniqueKeys.size(); ++k) {
+        chunk.ownedCount += owners[k].chunk == c;
       }
+    });
+
+    std::size_t vertexCount{0};
+
+    for (auto& chunk : chunks) {
+      chunk.vertexBase = vertexCount;
+      vertexCount += chunk.ownedCount;
     }
 
-    fStream.close();
+    std::vector<Vertex> vertexBuffer(vertexCount);  // Vertices
+    std::vector<std::array<std::size_t, 3>> indexBuffer(triCount); // Triangle indices
+
+    threadPool.ParallelFor(chunks.size(), [&](std::size_t c) {
+      auto& chunk{chunks[c]};
+      chunk.vertexIndices.resize(chunk.uniqueKeys.size());
+
+      std::size_t vertexIndex{chunk.vertexBase};
+
+      for (std::size_t k{0}; k < chunk.uniqueKeys.size(); ++k) {
+        if (chunkOwners[c][k].chunk != c) {
+          continue;
+        }
+
+        const VertexKey& vKey{chunk.uniqueKeys[k]};
+        vertexBuffer[vertexIndex] = Vertex{v[vKey.vIndex], vKey.vnIndex != k_NoIndex ? vn[vKey.vnIndex] : Vector3{}};
+        chunk.vertexIndices[k] = vertexIndex++;
+      }
+    });
+
+    // The keys owned by other chunks take the index assigned there
+    threadPool.ParallelFor(chunks.size(), [&](std::size_t c) {
+      auto& chunk{chunks[c]};
+
+      for (std::size_t k{0}; k < chunk.uniqueKeys.size(); ++k) {
+        const KeyOwner& owner{chunkOwners[c][k]};
+
+        if (owner.chunk != c) {
+          chunk.vertexIndices[k] = chunks[owner.chunk].vertexIndices[owner.key];
+        }
+      }
+
+      for (std::size_t i{0}; i < chunk.triCount; ++i) {
+        indexBuffer[chunk.triBase + i] = {
+          chunk.vertexIndices[chunk.cornerKeys[3 * i]],
+          chunk.vertexIndices[chunk.cornerKeys[3 * i + 1]],
+          chunk.vertexIndices[chunk.cornerKeys[3 * i + 2]]
+        };
+      }
+    });
 
     if (vertexBuffer.size() == 0 || indexBuffer.size() == 0) {
       throw std::invalid_argument("EXCEPTION: the mesh file format is not supported");
     }
 
-    return Mesh{vertexBuffer, indexBuffer};
+    return Mesh{std::move(vertexBuffer), std::move(indexBuffer)};
   }
   
 }
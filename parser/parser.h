@@ -11,7 +11,12 @@ namespace engine {
   public:
     Parser() = delete;
 
+    // Reads the binary cache of the file when it is up to date, otherwise
+    // parses the file (reordering it for the vertex cache when
+    // g_OptimizeVertexCache is set) and writes the cache for the next launches
     static Mesh LoadMeshFromFile(const std::string& filePath);
+
+    static Mesh ParseObjFile(const std::string& filePath);
   };
   
 }
@@ -0,0 +1,361 @@
+#include "presenter.h"
+
+#include "profiler/profiler.h"
+#include "settings.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <climits>
+#include <cstring>
+#include <utility>
+
+#include <unistd.h>
+
+namespace engine {
+  // REMEMBER: the following constants and functions are used exclusively inside this file
+
+  constexpr std::size_t k_SkipBlockSize{8};
+  constexpr std::size_t k_MaxDigitCount{20};     // Of a 64-bit value
+  constexpr std::size_t k_MaxEscapeSize{48};
+  constexpr char k_CursorHome[]{"\033[H"};
+  constexpr char k_ClearTerminal[]{"\033[H\033[2J"};
+
+  static std::size_t GetDigitCount(std::size_t value) {
+    std::size_t digitCount{1};
+
+    for (; value >= 10; value /= 10) {
+      ++digitCount;
+    }
+
+    return digitCount;
+  }
+
+  // Length of the escape sequence appended by AppendCursorPosition()
+  static std::size_t GetCursorPositionLength(std::size_t row, std::size_t col) {
+    return 4 + GetDigitCount(row + 1) + GetDigitCount(col + 1);
+  }
+
+  Presenter::Presenter(const Screen& screen, int fd, PresentPolicy policy) :
+    m_Fd{fd},
+    m_Policy{policy},
+    m_HasPendingFrame{false},
+    m_IsPresenting{false},
+    m_IsInvalidationRequested{false},
+    m_IsStopping{false},
+    m_IsPresentedFrameValid{false},
+    m_EscapesSize{0},
+    m_LastFrameBytes{0},
+    m_TotalBytes{0},
+    m_FullRedrawCount{0},
+    m_DroppedFrameCount{0}
+  {
+    for (TerminalFrame* frame : {&m_BackFrame, &m_PendingFrame, &m_Frame, &m_PresentedFrame}) {
+      frame->rowWidth = 2 * static_cast<std::size_t>(screen.GetOutputWidth());
+      frame->rowCount = static_cast<std::size_t>(screen.GetOutputHeight());
+      frame->chars.resize((frame->rowWidth + 1) * frame->rowCount);
+    }
+
+    ReserveOutput();
+
+    m_Thread = std::thread{&Presenter::PresenterLoop, this};
+  }
+
+  Presenter::~Presenter() {
+    {
+      std::lock_guard<std::mutex> lock{m_Mutex};
+      m_IsStopping = true;
+    }
+
+    m_Condition.notify_all();
+    m_Thread.join();
+  }
+
+  PresentPolicy Presenter::GetPolicy() const { return m_Policy; }
+
+  std::size_t Presenter::GetLastFrameBytes() const { return m_LastFrameBytes; }
+
+  std::uint64_t Presenter::GetTotalBytes() const { return m_TotalBytes; }
+
+  std::size_t Presenter::GetFullRedrawCount() const { return m_FullRedrawCount; }
+
+  std::size_t Presenter::GetDroppedFrameCount() const { return m_DroppedFrameCount; }
+
+  // The screen is composed outside of the lock, so the presenter thread is
+  // only blocked for the swap of the two frames
+  void Presenter::Submit(const Screen& screen) {
+    ScopedTimer timer{ProfilerStage::Present};
+
+    m_BackFrame.rowWidth = 2 * static_cast<std::size_t>(screen.GetOutputWidth());
+    m_BackFrame.rowCount = static_cast<std::size_t>(screen.GetOutputHeight());
+    screen.ComposeFrame(m_BackFrame.chars);
+
+    {
+      std::unique_lock<std::mutex> lock{m_Mutex};
+
+      if (m_Policy == PresentPolicy::WaitForPresenter) {
+        m_Condition.wait(lock, [this]() { return !m_HasPendingFrame && !m_IsPresenting; });
+      }
+      else if (m_HasPendingFrame) {
+        ++m_DroppedFrameCount;
+      }
+
+      std::swap(m_BackFrame, m_PendingFrame);
+      m_HasPendingFrame = true;
+    }
+
+    m_Condition.notify_all();
+  }
+
+  void Presenter::WaitUntilIdle() {
+    std::unique_lock<std::mutex> lock{m_Mutex};
+    m_Condition.wait(lock, [this]() { return !m_HasPendingFrame && !m_IsPresenting; });
+  }
+
+  void Presenter::InvalidatePresentedFrame() {
+    std::lock_guard<std::mutex> lock{m_Mutex};
+    m_IsInvalidationRequested = true;
+  }
+
+  void Presenter::PresenterLoop() {
+    while (true) {
+      bool isInvalidated{false};
+
+      {
+        std::unique_lock<std::mutex> lock{m_Mutex};
+        m_Condition.wait(lock, [this]() { return m_IsStopping || m_HasPendingFrame; });
+
+        // The last pending frame is still written when stopping
+        if (!m_HasPendingFrame) {
+          return;
+        }
+
+        std::swap(m_PendingFrame, m_Frame);
+        m_HasPendingFrame = false;
+        m_IsPresenting = true;
+
+        isInvalidated = m_IsInvalidationRequested;
+        m_IsInvalidationRequested = false;
+      }
+
+      Present(isInvalidated);
+
+      {
+        std::lock_guard<std::mutex> lock{m_Mutex};
+        m_IsPresenting = false;
+      }
+
+      m_Condition.notify_all();
+    }
+  }
+
+  void Presenter::Present(bool isInvalidated) {
+    bool isSameLayout{
+      m_Frame.rowWidth == m_PresentedFrame.rowWidth &&
+      m_Frame.rowCount == m_PresentedFrame.rowCount
+    };
+
+    if (isInvalidated || !isSameLayout) {
+      m_IsPresentedFrameValid = false;
+    }
+
+    ReserveOutput();
+
+    m_EscapesSize = 0;
+    m_Segments.clear();
+
+    bool isDifferential{g_UseDifferentialOutput && m_IsPresentedFrameValid && AppendChangedRuns()};
+
+    if (!isDifferential) {
+      m_EscapesSize = 0;
+      m_Segments.clear();
+      AppendFullRedraw(!g_UseDifferentialOutput || !m_IsPresentedFrameValid);
+      ++m_FullRedrawCount;
+    }
+
+    std::size_t frameBytes{0};
+    for (const iovec& segment : m_Segments) {
+      frameBytes += segment.iov_len;
+    }
+
+    // After a failed write the content of the terminal is unknown
+    m_IsPresentedFrameValid = WriteSegments();
+    std::swap(m_Frame, m_PresentedFrame);
+
+    m_LastFrameBytes = frameBytes;
+    m_TotalBytes += frameBytes;
+  }
+
+  // A differential frame is abandoned as soon as it becomes larger than a
+  // full redraw, which bounds the output of both. The buffers only grow
+  // when the resolution changes
+  void Presenter::ReserveOutput() {
+    std::size_t maxFrameBytes{m_Frame.chars.size() + m_Frame.rowWidth + 2 * k_MaxEscapeSize};
+
+    if (m_Escapes.size() < maxFrameBytes) {
+      m_Escapes.resize(maxFrameBytes);
+    }
+
+    // Every run takes a cursor move and at least one character
+    m_Segments.reserve(maxFrameBytes / 3 + 4);
+  }
+
+  bool Presenter::AppendEscape(const char* data, std::size_t size) {
+    if (m_EscapesSize + size > m_Escapes.size()) {
+      return false;
+    }
+
+    char* destination{m_Escapes.data() + m_EscapesSize};
+    std::memcpy(destination, data, size);
+    m_EscapesSize += size;
+
+    m_Segments.push_back(iovec{destination, size});
+
+    return true;
+  }
+
+  // Moves the cursor to a 0-based position (the terminal counts from 1)
+  bool Presenter::AppendCursorPosition(std::size_t row, std::size_t col) {
+    char buffer[k_MaxEscapeSize];
+    char* end{buffer};
+
+    *end++ = '\033';
+    *end++ = '[';
+    end = std::to_chars(end, end + k_MaxDigitCount, row + 1).ptr;
+    *end++ = ';';
+    end = std::to_chars(end, end + k_MaxDigitCount, col + 1).ptr;
+    *end++ = 'H';
+
+    return AppendEscape(buffer, static_cast<std::size_t>(end - buffer));
+  }
+
+  // Every row is printed entirely, so clearing the terminal is only needed
+  // when its content is unknown
+  void Presenter::AppendFullRedraw(bool clearTerminal) {
+    if (clearTerminal) {
+      AppendEscape(k_ClearTerminal, sizeof(k_ClearTerminal) - 1);
+    }
+    else {
+      AppendEscape(k_CursorHome, sizeof(k_CursorHome) - 1);
+    }
+
+    m_Segments.push_back(iovec{m_Frame.chars.data(), m_Frame.chars.size()});
+  }
+
+  // Appends a cursor move followed by the new characters for each run that
+  // differs from the presented frame. Unchanged characters between two runs
+  // are reprinted when they are cheaper than the cursor move they replace.
+  // Returns false as soon as the output becomes larger than a full redraw
+  bool Presenter::AppendChangedRuns() {
+    const std::size_t rowWidth{m_Frame.rowWidth};
+    const std::size_t rowStride{rowWidth + 1};
+    const std::size_t h{m_Frame.rowCount};
+    const std::size_t fullRedrawBytes{sizeof(k_CursorHome) - 1 + m_Frame.chars.size()};
+
+    std::size_t frameBytes{0};
+
+    // After a frame the cursor is left at the beginning of the row below the screen
+    std::size_t cursorRow{h};
+    std::size_t cursorCol{0};
+
+    for (std::size_t i{0}; i < h; ++i) {
+      char* next{m_Frame.chars.data() + i * rowStride};
+      const char* presented{m_PresentedFrame.chars.data() + i * rowStride};
+
+      // Most rows usually did not change at all
+      if (std::memcmp(next, presented, rowWidth) == 0) {
+        continue;
+      }
+
+      std::size_t col{0};
+
+      while (col < rowWidth) {
+        // Unchanged characters are skipped in blocks first
+        while (col + k_SkipBlockSize <= rowWidth && std::memcmp(next + col, presented + col, k_SkipBlockSize) == 0) {
+          col += k_SkipBlockSize;
+        }
+
+        if (col == rowWidth) {
+          break;
+        }
+
+        if (next[col] == presented[col]) {
+          ++col;
+          continue;
+        }
+
+        std::size_t runEnd{col + 1};
+        const std::size_t maxGap{GetCursorPositionLength(i, runEnd)};
+
+        for (std::size_t j{runEnd}; j < rowWidth && j - runEnd <= maxGap; ++j) {
+          if (next[j] != presented[j]) {
+            runEnd = j + 1;
+          }
+        }
+
+        if (cursorRow != i || cursorCol != col) {
+          std::size_t escapesSize{m_EscapesSize};
+
+          if (!AppendCursorPosition(i, col)) {
+            return false;
+          }
+
+          frameBytes += m_EscapesSize - escapesSize;
+        }
+
+        m_Segments.push_back(iovec{next + col, runEnd - col});
+        frameBytes += runEnd - col;
+
+        cursorRow = i;
+        cursorCol = runEnd;
+        col = runEnd;
+
+        if (frameBytes > fullRedrawBytes) {
+          return false;
+        }
+      }
+    }
+
+    if (!m_Segments.empty()) {
+      return AppendCursorPosition(h, 0);
+    }
+
+    return true;
+  }
+
+  // writev() may write only a part of the segments (e.g. when interrupted
+  // by a signal), in which case the rest is written by the next calls
+  bool Presenter::WriteSegments() {
+    iovec* segments{m_Segments.data()};
+    std::size_t segmentCount{m_Segments.size()};
+
+    while (segmentCount > 0) {
+      const int batchSize{static_cast<int>(std::min<std::size_t>(segmentCount, IOV_MAX))};
+      ssize_t written{writev(m_Fd, segments, batchSize)};
+
+      if (written < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+
+        return false;
+      }
+
+      std::size_t remaining{static_cast<std::size_t>(written)};
+
+      while (segmentCount > 0 && remaining >= segments->iov_len) {
+        remaining -= segments->iov_len;
+        ++segments;
+        --segmentCount;
+      }
+
+      if (segmentCount > 0) {
+        segments->iov_base = static_cast<char*>(segments->iov_base) + remaining;
+        segments->iov_len -= remaining;
+      }
+    }
+
+    return true;
+  }
+
+}
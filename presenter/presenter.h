@@ -0,0 +1,99 @@
+#ifndef PRESENTER_H
+#define PRESENTER_H
+
+#include "screen/screen.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <sys/uio.h>
+
+// The presenter owns the terminal: a dedicated thread writes the frames
+// with writev(), so that the next frame is rendered while the previous one
+// is being written out. Submit() only composes the screen into the back
+// frame and swaps it with the pending one.
+// The terminal keeps what was printed, so after the first frame only the
+// runs of characters that changed since the previously presented frame are
+// emitted, each one preceded by a cursor-positioning escape. When this would
+// take more bytes than reprinting everything, the whole frame is redrawn
+
+namespace engine {
+
+  enum class PresentPolicy {
+    WaitForPresenter,   // Submit() waits until the previous frame has been written
+    DropStaleFrames     // Submit() never waits: a frame not written yet is replaced
+  };
+
+  class Presenter {
+  public:
+    // The buffers are sized for the current resolution of the screen, and
+    // only grow when it changes
+    Presenter(const Screen& screen, int fd, PresentPolicy policy);
+    ~Presenter();     // Writes the pending frame before returning
+
+    Presenter(const Presenter&) = delete;
+    Presenter& operator=(const Presenter&) = delete;
+
+    // Getters
+    PresentPolicy GetPolicy() const;
+    std::size_t GetLastFrameBytes() const;      // Bytes written for the last presented frame
+    std::uint64_t GetTotalBytes() const;
+    std::size_t GetFullRedrawCount() const;
+    std::size_t GetDroppedFrameCount() const;
+
+    void Submit(const Screen& screen);
+    void WaitUntilIdle();                       // Returns once every submitted frame has been written or dropped
+    void InvalidatePresentedFrame();            // The next frame is fully redrawn (e.g. after the terminal changed)
+
+  private:
+    struct TerminalFrame {
+      std::vector<char> chars;    // Rows of rowWidth characters followed by '\n'
+      std::size_t rowWidth{0};
+      std::size_t rowCount{0};
+    };
+
+    int m_Fd;
+    PresentPolicy m_Policy;
+
+    std::mutex m_Mutex;
+    std::condition_variable m_Condition;
+    TerminalFrame m_BackFrame;                  // Render thread only
+    TerminalFrame m_PendingFrame;
+    bool m_HasPendingFrame;
+    bool m_IsPresenting;
+    bool m_IsInvalidationRequested;
+    bool m_IsStopping;
+
+    // Presenter thread only
+    TerminalFrame m_Frame;
+    TerminalFrame m_PresentedFrame;
+    bool m_IsPresentedFrameValid;
+    std::vector<char> m_Escapes;                // Storage of the escape sequences referenced by m_Segments
+    std::size_t m_EscapesSize;
+    std::vector<iovec> m_Segments;
+
+    std::atomic<std::size_t> m_LastFrameBytes;
+    std::atomic<std::uint64_t> m_TotalBytes;
+    std::atomic<std::size_t> m_FullRedrawCount;
+    std::atomic<std::size_t> m_DroppedFrameCount;
+
+    std::thread m_Thread;                       // Started last, as it uses every other member
+
+    void PresenterLoop();
+    void Present(bool isInvalidated);
+    void ReserveOutput();
+    bool AppendEscape(const char* data, std::size_t size);
+    bool AppendCursorPosition(std::size_t row, std::size_t col);
+    void AppendFullRedraw(bool clearTerminal);
+    bool AppendChangedRuns();
+    bool WriteSegments();
+  };
+
+}
+
+#endif
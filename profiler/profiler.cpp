@@ -0,0 +1,107 @@
+#include "profiler.h"
+
+#include "time/time.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace engine {
+
+  std::array<std::array<float, Profiler::k_HistorySize>, Profiler::k_StageCount> Profiler::s_History{};
+  std::array<float, Profiler::k_StageCount> Profiler::s_CurrentFrame{};
+  std::size_t Profiler::s_NextIndex{0};
+  std::size_t Profiler::s_FrameCount{0};
+
+  ProfilerStats Profiler::GetStats(ProfilerStage stage) {
+    ProfilerStats stats{};
+
+    if (s_FrameCount == 0) {
+      return stats;
+    }
+
+    // The samples are copied so that the ring buffer keeps its order
+    const auto& history{s_History[static_cast<std::size_t>(stage)]};
+    std::array<float, k_HistorySize> samples;
+    std::copy(history.begin(), history.begin() + s_FrameCount, samples.begin());
+
+    auto begin{samples.begin()};
+    auto end{samples.begin() + s_FrameCount};
+
+    float sum{0.0f};
+    for (auto it{begin}; it != end; ++it) {
+      sum += *it;
+    }
+
+    std::sort(begin, end);
+
+    stats.avgMs = sum / static_cast<float>(s_FrameCount);
+    stats.p50Ms = samples[(s_FrameCount - 1) / 2];
+    stats.p99Ms = samples[(s_FrameCount - 1) * 99 / 100];
+    stats.maxMs = samples[s_FrameCount - 1];
+
+    return stats;
+  }
+
+  const char* Profiler::GetStageName(ProfilerStage stage) {
+    switch (stage) {
+      case ProfilerStage::Frame:            return "frame";
+      case ProfilerStage::ProcessMesh:      return "process mesh";
+      case ProfilerStage::FrustumCulling:   return "  frustum culling";
+      case ProfilerStage::BackfaceCulling:  return "  backface culling";
+      case ProfilerStage::FlatShading:      return "  flat shading";
+      case ProfilerStage::VertexProcessing: return "  vertex processing";
+      case ProfilerStage::Clipping:         return "  clipping";
+      case ProfilerStage::RasterizeMesh:    return "rasterize mesh";
+      case ProfilerStage::Present:          return "present";
+      default:                              return "unknown";
+    }
+  }
+
+  // One line per stage, in milliseconds. The lines have a fixed width, so
+  // once they have been allocated the strings are only overwritten
+  void Profiler::GetReportLines(std::vector<std::string>& lines) {
+    lines.resize(k_StageCount + 1);
+
+    char buffer[128];
+    std::snprintf(buffer, sizeof(buffer), "%-20s %8s %8s %8s %8s  (ms, last %3zu frames)", 
+      "stage", "avg", "p50", "p99", "max", s_FrameCount);
+    lines[0].assign(buffer);
+
+    for (std::size_t i{0}; i < k_StageCount; ++i) {
+      ProfilerStage stage{static_cast<ProfilerStage>(i)};
+      ProfilerStats stats{GetStats(stage)};
+
+      std::snprintf(buffer, sizeof(buffer), "%-20s %8.3f %8.3f %8.3f %8.3f", 
+        GetStageName(stage), stats.avgMs, stats.p50Ms, stats.p99Ms, stats.maxMs);
+      lines[i + 1].assign(buffer);
+    }
+  }
+
+  void Profiler::AddSample(ProfilerStage stage, float ms) {
+    s_CurrentFrame[static_cast<std::size_t>(stage)] += ms;
+  }
+
+  void Profiler::EndFrame() {
+    for (std::size_t i{0}; i < k_StageCount; ++i) {
+      s_History[i][s_NextIndex] = s_CurrentFrame[i];
+    }
+
+    s_CurrentFrame.fill(0.0f);
+    s_NextIndex = (s_NextIndex + 1) % k_HistorySize;
+    s_FrameCount = std::min(s_FrameCount + 1, k_HistorySize);
+  }
+
+  void Profiler::Reset() {
+    s_CurrentFrame.fill(0.0f);
+    s_NextIndex = 0;
+    s_FrameCount = 0;
+  }
+
+  ScopedTimer::ScopedTimer(ProfilerStage stage) : m_Stage{stage}, m_Start{Time::GetTimestamp()} {}
+
+  ScopedTimer::~ScopedTimer() {
+    std::chrono::duration<float, std::milli> elapsed{Time::GetTimestamp() - m_Start};
+    Profiler::AddSample(m_Stage, elapsed.count());
+  }
+  
+}
@@ -0,0 +1,77 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// This script measures how long each stage of the pipeline takes, frame by
+// frame. The last k_HistorySize frames are kept in a fixed-size ring buffer, 
+// from which the statistics shown by the overlay are computed
+
+namespace engine {
+
+  enum class ProfilerStage {
+    Frame,
+    ProcessMesh,
+    FrustumCulling,
+    BackfaceCulling,
+    FlatShading,
+    VertexProcessing,
+    Clipping,
+    RasterizeMesh,
+    Present,
+    Count
+  };
+
+  struct ProfilerStats {
+    float avgMs{0.0f};
+    float p50Ms{0.0f};
+    float p99Ms{0.0f};
+    float maxMs{0.0f};
+  };
+
+  class Profiler {
+  public:
+    Profiler() = delete;
+
+    static constexpr std::size_t k_HistorySize{256};
+
+    // Getters
+    static ProfilerStats GetStats(ProfilerStage stage);
+    static const char* GetStageName(ProfilerStage stage);
+    static void GetReportLines(std::vector<std::string>& lines);   // Reuses the strings of lines
+
+    static void AddSample(ProfilerStage stage, float ms);   // Accumulates into the current frame
+    static void EndFrame();                                 // Pushes the current frame into the history
+    static void Reset();
+
+  private:
+    static constexpr std::size_t k_StageCount{static_cast<std::size_t>(ProfilerStage::Count)};
+
+    static std::array<std::array<float, k_HistorySize>, k_StageCount> s_History;
+    static std::array<float, k_StageCount> s_CurrentFrame;
+    static std::size_t s_NextIndex;     // Position of the next frame inside the ring buffer
+    static std::size_t s_FrameCount;    // Number of valid frames (up to k_HistorySize)
+  };
+
+  // Adds the time elapsed between its construction and its destruction
+  // to the given stage
+  class ScopedTimer {
+  public:
+    explicit ScopedTimer(ProfilerStage stage);
+    ~ScopedTimer();
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+  private:
+    ProfilerStage m_Stage;
+    std::chrono::high_resolution_clock::time_point m_Start;
+  };
+  
+}
+
+#endif
@@ -0,0 +1,192 @@
+#include "pixel_kernel.h"
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define ENGINE_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace engine {
+
+  static constexpr int k_BlockSize{8};
+
+  // Processes the first pixelCount lanes of a block one at a time. Used by
+  // the scalar kernel and for the last, incomplete block of the SIMD kernels
+  static inline void RasterizeBlockScalar(const SpanSetup& block, const SpanSetup& spanSetup, 
+    int pixelCount, float* zRow, char* pixelRow, char pixelChar) 
+  {
+    for (int i{0}; i < pixelCount; ++i) {
+      const float lane{static_cast<float>(i)};
+
+      const float w0{block.w0 + lane * spanSetup.w0Dx};
+      const float w1{block.w1 + lane * spanSetup.w1Dx};
+      const float w2{block.w2 + lane * spanSetup.w2Dx};
+      const float z{block.z + lane * spanSetup.zDx};
+
+      // The <= operator is used because the vertices are ordered clock-wise
+      if (w0 <= 0.0f && w1 <= 0.0f && w2 <= 0.0f && z < zRow[i]) {
+        zRow[i] = z;
+        pixelRow[i] = pixelChar;
+      }
+    }
+  }
+
+  static void RasterizeSpanScalar(const SpanSetup& spanSetup, int pixelCount, float* zRow, char* pixelRow, char pixelChar) {
+    const float blockSize{static_cast<float>(k_BlockSize)};
+    SpanSetup block{spanSetup};
+
+    for (int x{0}; x < pixelCount; x += k_BlockSize) {
+      RasterizeBlockScalar(block, spanSetup, std::min(k_BlockSize, pixelCount - x), zRow + x, pixelRow + x, pixelChar);
+
+      block.w0 += spanSetup.w0Dx * blockSize;
+      block.w1 += spanSetup.w1Dx * blockSize;
+      block.w2 += spanSetup.w2Dx * blockSize;
+      block.z += spanSetup.zDx * blockSize;
+    }
+  }
+
+#ifdef ENGINE_X86_KERNELS
+
+  // Writes the char of every lane whose bit is set in the mask
+  static inline void StoreMaskedChars(int mask, char* pixelRow, char pixelChar) {
+    while (mask != 0) {
+      pixelRow[__builtin_ctz(static_cast<unsigned>(mask))] = pixelChar;
+      mask &= mask - 1;
+    }
+  }
+
+  // A block of 8 pixels is handled as two halves of 4
+  __attribute__((target("sse4.1")))
+  static void RasterizeSpanSse41(const SpanSetup& spanSetup, int pixelCount, float* zRow, char* pixelRow, char pixelChar) {
+    const float blockSize{static_cast<float>(k_BlockSize)};
+    const __m128 zero{_mm_setzero_ps()};
+    const __m128 lanes[2]{_mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f), _mm_setr_ps(4.0f, 5.0f, 6.0f, 7.0f)};
+
+    __m128 offsets[2][4];
+    for (int h{0}; h < 2; ++h) {
+      offsets[h][0] = _mm_mul_ps(lanes[h], _mm_set1_ps(spanSetup.w0Dx));
+      offsets[h][1] = _mm_mul_ps(lanes[h], _mm_set1_ps(spanSetup.w1Dx));
+      offsets[h][2] = _mm_mul_ps(lanes[h], _mm_set1_ps(spanSetup.w2Dx));
+      offsets[h][3] = _mm_mul_ps(lanes[h], _mm_set1_ps(spanSetup.zDx));
+    }
+
+    SpanSetup block{spanSetup};
+    int x{0};
+
+    for (; x + k_BlockSize <= pixelCount; x += k_BlockSize) {
+      for (int h{0}; h < 2; ++h) {
+        const int laneStart{h * 4};
+
+        __m128 w0{_mm_add_ps(_mm_set1_ps(block.w0), offsets[h][0])};
+        __m128 w1{_mm_add_ps(_mm_set1_ps(block.w1), offsets[h][1])};
+        __m128 w2{_mm_add_ps(_mm_set1_ps(block.w2), offsets[h][2])};
+
+        __m128 inside{_mm_and_ps(_mm_and_ps(_mm_cmple_ps(w0, zero), _mm_cmple_ps(w1, zero)), _mm_cmple_ps(w2, zero))};
+
+        if (_mm_movemask_ps(inside) == 0) {
+          continue;
+        }
+
+        __m128 z{_mm_add_ps(_mm_set1_ps(block.z), offsets[h][3])};
+        __m128 zOld{_mm_loadu_ps(zRow + x + laneStart)};
+        __m128 pass{_mm_and_ps(inside, _mm_cmplt_ps(z, zOld))};
+        int mask{_mm_movemask_ps(pass)};
+
+        if (mask != 0) {
+          _mm_storeu_ps(zRow + x + laneStart, _mm_blendv_ps(zOld, z, pass));
+          StoreMaskedChars(mask, pixelRow + x + laneStart, pixelChar);
+        }
+      }
+
+      block.w0 += spanSetup.w0Dx * blockSize;
+      block.w1 += spanSetup.w1Dx * blockSize;
+      block.w2 += spanSetup.w2Dx * blockSize;
+      block.z += spanSetup.zDx * blockSize;
+    }
+
+    RasterizeBlockScalar(block, spanSetup, pixelCount - x, zRow + x, pixelRow + x, pixelChar);
+  }
+
+  __attribute__((target("avx2")))
+  static void RasterizeSpanAvx2(const SpanSetup& spanSetup, int pixelCount, float* zRow, char* pixelRow, char pixelChar) {
+    const float blockSize{static_cast<float>(k_BlockSize)};
+    const __m256 zero{_mm256_setzero_ps()};
+    const __m256 lanes{_mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f)};
+
+    const __m256 w0Offsets{_mm256_mul_ps(lanes, _mm256_set1_ps(spanSetup.w0Dx))};
+    const __m256 w1Offsets{_mm256_mul_ps(lanes, _mm256_set1_ps(spanSetup.w1Dx))};
+    const __m256 w2Offsets{_mm256_mul_ps(lanes, _mm256_set1_ps(spanSetup.w2Dx))};
+    const __m256 zOffsets{_mm256_mul_ps(lanes, _mm256_set1_ps(spanSetup.zDx))};
+
+    SpanSetup block{spanSetup};
+    int x{0};
+
+    for (; x + k_BlockSize <= pixelCount; x += k_BlockSize) {
+      __m256 w0{_mm256_add_ps(_mm256_set1_ps(block.w0), w0Offsets)};
+      __m256 w1{_mm256_add_ps(_mm256_set1_ps(block.w1), w1Offsets)};
+      __m256 w2{_mm256_add_ps(_mm256_set1_ps(block.w2), w2Offsets)};
+
+      __m256 inside{_mm256_and_ps(
+        _mm256_and_ps(_mm256_cmp_ps(w0, zero, _CMP_LE_OQ), _mm256_cmp_ps(w1, zero, _CMP_LE_OQ)), 
+        _mm256_cmp_ps(w2, zero, _CMP_LE_OQ)
+      )};
+
+      if (_mm256_movemask_ps(inside) != 0) {
+        __m256 z{_mm256_add_ps(_mm256_set1_ps(block.z), zOffsets)};
+        __m256 zOld{_mm256_loadu_ps(zRow + x)};
+        __m256 pass{_mm256_and_ps(inside, _mm256_cmp_ps(z, zOld, _CMP_LT_OQ))};
+        int mask{_mm256_movemask_ps(pass)};
+
+        if (mask != 0) {
+          _mm256_storeu_ps(zRow + x, _mm256_blendv_ps(zOld, z, pass));
+          StoreMaskedChars(mask, pixelRow + x, pixelChar);
+        }
+      }
+
+      block.w0 += spanSetup.w0Dx * blockSize;
+      block.w1 += spanSetup.w1Dx * blockSize;
+      block.w2 += spanSetup.w2Dx * blockSize;
+      block.z += spanSetup.zDx * blockSize;
+    }
+
+    RasterizeBlockScalar(block, spanSetup, pixelCount - x, zRow + x, pixelRow + x, pixelChar);
+  }
+
+#endif
+
+  SpanKernelType PixelKernel::GetBestSupportedType() {
+#ifdef ENGINE_X86_KERNELS
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2")) {
+      return SpanKernelType::Avx2;
+    }
+
+    if (__builtin_cpu_supports("sse4.1")) {
+      return SpanKernelType::Sse41;
+    }
+#endif
+
+    return SpanKernelType::Scalar;
+  }
+
+  SpanKernel PixelKernel::GetKernel(SpanKernelType type) {
+    switch (type) {
+#ifdef ENGINE_X86_KERNELS
+      case SpanKernelType::Avx2:    return RasterizeSpanAvx2;
+      case SpanKernelType::Sse41:   return RasterizeSpanSse41;
+#endif
+      default:                      return RasterizeSpanScalar;
+    }
+  }
+
+  const char* PixelKernel::GetTypeName(SpanKernelType type) {
+    switch (type) {
+      case SpanKernelType::Avx2:    return "avx2";
+      case SpanKernelType::Sse41:   return "sse4.1";
+      default:                      return "scalar";
+    }
+  }
+  
+}
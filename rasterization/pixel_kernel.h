@@ -0,0 +1,42 @@
+#ifndef PIXEL_KERNEL_H
+#define PIXEL_KERNEL_H
+
+// This script contains the innermost loop of the rasterizer: coverage test,
+// depth test and merging of a horizontal span of pixels of a triangle.
+// Pixels are processed in blocks of 8. The value of each lane is computed as
+// blockStart + lane * gradient, and blockStart is stepped by 8 * gradient,
+// in the same order of operations in every implementation, so the scalar,
+// SSE and AVX2 kernels produce bit-identical results
+
+namespace engine {
+
+  // Values of the edge functions and of the depth at the first pixel of the
+  // span, and how much they change when moving one pixel to the right
+  struct SpanSetup {
+    float w0, w1, w2, z;
+    float w0Dx, w1Dx, w2Dx, zDx;
+  };
+
+  // Tests pixelCount pixels starting from zRow[0] / pixelRow[0]: every pixel
+  // inside the triangle and closer than the z-buffer gets its depth and char
+  using SpanKernel = void (*)(const SpanSetup& spanSetup, int pixelCount, float* zRow, char* pixelRow, char pixelChar);
+
+  enum class SpanKernelType {
+    Scalar,
+    Sse41,
+    Avx2
+  };
+
+  class PixelKernel {
+  public:
+    PixelKernel() = delete;
+
+    // Getters
+    static SpanKernelType GetBestSupportedType();   // Checks the CPU features at runtime
+    static SpanKernel GetKernel(SpanKernelType type);
+    static const char* GetTypeName(SpanKernelType type);
+  };
+  
+}
+
+#endif
@@ -1,126 +1,395 @@
 #include "rasterization.h"
 
 #include "math/math.h"
+#include "profiler/profiler.h"
+#include "settings.h"
 
 #include <algorithm>
+#include <cmath>
 #include <limits>
 
 namespace engine {
     
-  Rasterization::Rasterization(Screen& screen) : 
+  Rasterization::Rasterization(Screen& screen, std::size_t threadCount) : 
     m_Screen{screen}, 
-    m_PixelChars{'.', ':', '-', '~', '=', '+', '*', '#', '%', '@'} 
+    m_PixelChars{'.', ':', '-', '~', '=', '+', '*', '#', '%', '@'},
+    m_SpanKernelType{PixelKernel::GetBestSupportedType()},
+    m_SpanKernel{PixelKernel::GetKernel(m_SpanKernelType)},
+    m_ThreadPool{threadCount},
+    m_TileCols{0},
+    m_TileRows{0},
+    m_HiZCols{0},
+    m_HiZRows{0}
   {}
 
+  void Rasterization::SetSpanKernelType(SpanKernelType spanKernelType) {
+    m_SpanKernelType = spanKernelType;
+    m_SpanKernel = PixelKernel::GetKernel(spanKernelType);
+  }
+
+  SpanKernelType Rasterization::GetSpanKernelType() const { return m_SpanKernelType; }
+
   void Rasterization::RasterizeMesh(const Mesh& mesh) {
+    ScopedTimer timer{ProfilerStage::RasterizeMesh};
+
     std::size_t resolution{static_cast<std::size_t>(m_Screen.GetWidth()) * static_cast<std::size_t>(m_Screen.GetHeight())};
 
     if (m_ZBuffer.size() != resolution) {
       m_ZBuffer.resize(resolution);
     }
 
-    // Set all the z-values to +infinity
-    std::fill(m_ZBuffer.begin(), m_ZBuffer.end(), std::numeric_limits<float>::infinity());
+    m_TileCols = (m_Screen.GetWidth() + k_TileSize - 1) / k_TileSize;
+    m_TileRows = (m_Screen.GetHeight() + k_TileSize - 1) / k_TileSize;
+
+    m_HiZCols = (m_Screen.GetWidth() + k_HiZBlockSize - 1) / k_HiZBlockSize;
+    m_HiZRows = (m_Screen.GetHeight() + k_HiZBlockSize - 1) / k_HiZBlockSize;
+
+    const std::size_t hiZSize{static_cast<std::size_t>(m_HiZCols * m_HiZRows)};
+
+    if (m_HiZ.size() != hiZSize) {
+      m_HiZ.resize(hiZSize);
+      m_HiZDirty.resize(hiZSize);
+    }
 
-    const auto& vertexBuffer{mesh.vertexBuffer};
-    const auto& indexBuffer{mesh.indexBuffer};
     const auto& triBrightness{mesh.triBrightness};
 
-    for (std::size_t i{0}; i < indexBuffer.size(); ++i) {
-      const auto& triIndices{indexBuffer[i]};
+    // The processed index buffer keeps the capacity of the whole mesh, so
+    // reserving it makes the setups stable while the visible count varies
+    m_TriSetups.clear();
+    m_TriSetups.reserve(mesh.indexBuffer.GetCapacity());
+
+    mesh.indexBuffer.Visit([&](const auto& indexBuffer) {
+      TriSetup triSetup;
+
+      for (std::size_t i{0}; i < indexBuffer.size(); ++i) {
+        const auto& triIndices{indexBuffer[i]};
+
+        const Vector3 p1{mesh.GetPosition(triIndices[0])};
+        const Vector3 p2{mesh.GetPosition(triIndices[1])};
+        const Vector3 p3{mesh.GetPosition(triIndices[2])};
+
+        if (SetupTriBorders(p1, p2, p3, triSetup) && SetupTri(p1, p2, p3, triBrightness[i], triSetup)) {
+          m_TriSetups.push_back(triSetup);
+        }
+      }
+    });
 
-      const Vertex& v1{vertexBuffer[triIndices[0]]};
-      const Vertex& v2{vertexBuffer[triIndices[1]]};
-      const Vertex& v3{vertexBuffer[triIndices[2]]};
+    BinTris();
 
-      SetupTriBorders(v1, v2, v3);
-      TraverseTri(v1, v2, v3, triBrightness[i]);
+    m_ThreadPool.ParallelFor(static_cast<std::size_t>(m_TileCols * m_TileRows), [this](std::size_t tileIndex) {
+      RasterizeTile(tileIndex);
+    });
+  }
+
+  // Computes the bounding box of the triangle clamped to the screen. Returns
+  // false when the triangle lies entirely outside of it. The coordinates are
+  // checked before being converted to int, as the conversion of a value out
+  // of its range (or NaN) is undefined
+  bool Rasterization::SetupTriBorders(const Vector3& p1, const Vector3& p2, const Vector3& p3, TriSetup& triSetup) const {
+    const float width{static_cast<float>(m_Screen.GetWidth())};
+    const float height{static_cast<float>(m_Screen.GetHeight())};
+
+    const auto [xMinF, xMaxF]{std::minmax({p1.x, p2.x, p3.x})};
+    const auto [yMinF, yMaxF]{std::minmax({p1.y, p2.y, p3.y})};
+
+    if (!(xMinF < width && xMaxF > -1.0f && yMinF < height && yMaxF > -1.0f)) {
+      return false;
     }
+
+    triSetup.xMin = static_cast<int>(std::max(xMinF, 0.0f));
+    triSetup.xMax = static_cast<int>(std::min(xMaxF, width - 1.0f));
+
+    triSetup.yMin = static_cast<int>(std::max(yMinF, 0.0f));
+    triSetup.yMax = static_cast<int>(std::min(yMaxF, height - 1.0f));
+
+    return triSetup.xMin <= triSetup.xMax && triSetup.yMin <= triSetup.yMax;
   }
 
-  void Rasterization::SetupTriBorders(const Vertex& v1, const Vertex& v2, const Vertex& v3) {
-    std::pair<float, float> pairFloat;
-        
-    pairFloat = std::minmax({v1.position.x, v2.position.x, v3.position.x});
-    m_XMin = static_cast<int>(pairFloat.first);
-    m_XMax = static_cast<int>(pairFloat.second);
+  // Computes the edge functions and the depth gradients of the triangle. 
+  // Each edge function is the z-component of the cross product between the 
+  // edge and the vector going from its first vertex to the point, expanded so
+  // that it becomes linear in x and y. Returns false for triangles with no
+  // area on the screen, as they cannot cover any pixel
+  bool Rasterization::SetupTri(const Vector3& p1, const Vector3& p2, const Vector3& p3, float triBrightness, TriSetup& triSetup) const {
+    const std::array<const Vector3*, 3> verts{&p1, &p2, &p3};
+
+    for (std::size_t i{0}; i < verts.size(); ++i) {
+      const Vector3& start{*verts[i]};
+      const Vector3& end{*verts[(i + 1) % verts.size()]};
+
+      Vector2 edge{end.x - start.x, end.y - start.y};
+
+      triSetup.edges[i].a = -edge.y;
+      triSetup.edges[i].b = edge.x;
+      triSetup.edges[i].c = edge.y * start.x - edge.x * start.y;
+    }
+
+    // The vector's components represents the coefficients of the plane's equation 
+    // (ax + by + cz + d = 0), from which z is expressed as a function of x and y
+    Vector3 triNormal{Math::CrossProduct(p2 - p1, p3 - p1)};
+
+    if (triNormal.z == 0.0f) {
+      return false;
+    }
+
+    float d{-Math::DotProduct(triNormal, p1)};
+
+    triSetup.zDx = -triNormal.x / triNormal.z;
+    triSetup.zDy = -triNormal.y / triNormal.z;
+    triSetup.zC = -d / triNormal.z;
+    triSetup.zMin = std::min({p1.z, p2.z, p3.z});
+    triSetup.pixelChar = GetPixelChar(triBrightness);
 
-    pairFloat = std::minmax({v1.position.y, v2.position.y, v3.position.y});
-    m_YMin = static_cast<int>(pairFloat.first);
-    m_YMax = static_cast<int>(pairFloat.second);
+    return true;
   }
 
-  void Rasterization::TraverseTri(const Vertex& v1, const Vertex& v2, const Vertex& v3, float triBrightness) {
-    for (int y{m_YMax}; y >= m_YMin; --y) {
-      for (int x{m_XMin}; x <= m_XMax; ++x) {
-        if (m_Screen.IsPixelValid(x, y)) {
-          Vector2 point{static_cast<float>(x), static_cast<float>(y)};
+  // Counting sort of the triangles by tile: the first pass counts the
+  // triangles of each tile, the prefix sum turns the counts into offsets, and
+  // the second pass writes the indices. Since the triangles are visited in
+  // order, each tile receives them in the same order as the index buffer
+  void Rasterization::BinTris() {
+    const std::size_t tileCount{static_cast<std::size_t>(m_TileCols * m_TileRows)};
+    const std::size_t triCount{m_TriSetups.size()};
 
-          if (IsPointInsideTri(point, v1, v2, v3)) {
-            float zValue{CalculateZValue(v1, v2, v3, point)};
-            HandlePixelShading(x, y, triBrightness, zValue);
-          }
+    m_TileOffsets.assign(tileCount + 1, 0);
+    m_TileBins.reserve(m_TriSetups.capacity() * k_MaxBinnedTiles);
+    m_LargeTris.reserve(m_TriSetups.capacity());
+    m_LargeTris.clear();
+
+    auto isLarge = [](const TriSetup& triSetup) {
+      int tileCols{triSetup.xMax / k_TileSize - triSetup.xMin / k_TileSize + 1};
+      int tileRows{triSetup.yMax / k_TileSize - triSetup.yMin / k_TileSize + 1};
+
+      return tileCols * tileRows > k_MaxBinnedTiles;
+    };
+
+    for (std::uint32_t i{0}; i < triCount; ++i) {
+      const TriSetup& triSetup{m_TriSetups[i]};
+
+      if (isLarge(triSetup)) {
+        m_LargeTris.push_back(i);
+        continue;
+      }
+
+      for (int tileRow{triSetup.yMin / k_TileSize}; tileRow <= triSetup.yMax / k_TileSize; ++tileRow) {
+        for (int tileCol{triSetup.xMin / k_TileSize}; tileCol <= triSetup.xMax / k_TileSize; ++tileCol) {
+          ++m_TileOffsets[static_cast<std::size_t>(tileRow * m_TileCols + tileCol) + 1];
         }
       }
     }
-  }
 
-  void Rasterization::HandlePixelShading(int x, int y, float triBrightness, float zValue) {
-    std::size_t index = static_cast<std::size_t>(triBrightness * static_cast<float>((m_PixelChars.size() - 1)));
-    index = std::min(index, m_PixelChars.size() - 1);
+    for (std::size_t i{1}; i <= tileCount; ++i) {
+      m_TileOffsets[i] += m_TileOffsets[i - 1];
+    }
+
+    m_TileBins.resize(m_TileOffsets[tileCount]);
+
+    // m_TileOffsets[t] is used as the write cursor of tile t, so at the end
+    // it points to the start of tile t + 1 and the array is shifted by one
+    for (std::uint32_t i{0}; i < triCount; ++i) {
+      const TriSetup& triSetup{m_TriSetups[i]};
 
-    HandleMerging(y, x, m_PixelChars[index], zValue);
+      if (isLarge(triSetup)) {
+        continue;
+      }
+
+      for (int tileRow{triSetup.yMin / k_TileSize}; tileRow <= triSetup.yMax / k_TileSize; ++tileRow) {
+        for (int tileCol{triSetup.xMin / k_TileSize}; tileCol <= triSetup.xMax / k_TileSize; ++tileCol) {
+          std::size_t tileIndex{static_cast<std::size_t>(tileRow * m_TileCols + tileCol)};
+          m_TileBins[m_TileOffsets[tileIndex]++] = i;
+        }
+      }
+    }
+
+    for (std::size_t i{tileCount}; i > 0; --i) {
+      m_TileOffsets[i] = m_TileOffsets[i - 1];
+    }
+
+    m_TileOffsets[0] = 0;
   }
 
-  void Rasterization::HandleMerging(int row, int col, char pixelChar, float zValue) {
-    std::size_t index{static_cast<std::size_t>(row) * m_Screen.GetWidth() + static_cast<std::size_t>(col)};
+  // Clears the tile's slice of the z-buffer and of the coarse depth buffer,
+  // then draws its triangles
+  void Rasterization::RasterizeTile(std::size_t tileIndex) {
+    const int tileX{static_cast<int>(tileIndex) % m_TileCols * k_TileSize};
+    const int tileY{static_cast<int>(tileIndex) / m_TileCols * k_TileSize};
+    const int tileXMax{std::min(tileX + k_TileSize, m_Screen.GetWidth()) - 1};
+    const int tileYMax{std::min(tileY + k_TileSize, m_Screen.GetHeight()) - 1};
+
+    const std::size_t width{static_cast<std::size_t>(m_Screen.GetWidth())};
 
-    if (zValue < m_ZBuffer[index]) {
-      m_ZBuffer[index] = zValue;
-      m_Screen.SetScreenPixel(row, col, pixelChar);
+    for (int y{tileY}; y <= tileYMax; ++y) {
+      auto rowStart{m_ZBuffer.begin() + static_cast<std::ptrdiff_t>(static_cast<std::size_t>(y) * width)};
+      std::fill(rowStart + tileX, rowStart + tileXMax + 1, std::numeric_limits<float>::infinity());
+    }
+
+    for (int blockRow{tileY / k_HiZBlockSize}; blockRow <= tileYMax / k_HiZBlockSize; ++blockRow) {
+      const std::size_t rowOffset{static_cast<std::size_t>(blockRow * m_HiZCols)};
+      const std::size_t blockStart{rowOffset + static_cast<std::size_t>(tileX / k_HiZBlockSize)};
+      const std::size_t blockEnd{rowOffset + static_cast<std::size_t>(tileXMax / k_HiZBlockSize) + 1};
+
+      std::fill(m_HiZ.begin() + static_cast<std::ptrdiff_t>(blockStart), m_HiZ.begin() + static_cast<std::ptrdiff_t>(blockEnd), 
+        std::numeric_limits<float>::infinity());
+      std::fill(m_HiZDirty.begin() + static_cast<std::ptrdiff_t>(blockStart), m_HiZDirty.begin() + static_cast<std::ptrdiff_t>(blockEnd), 0);
+    }
+
+    // Merges the tile's own triangles with the large ones overlapping it,
+    // both sorted by index, so that the order of the index buffer is kept
+    auto binIt{m_TileBins.begin() + m_TileOffsets[tileIndex]};
+    const auto binEnd{m_TileBins.begin() + m_TileOffsets[tileIndex + 1]};
+    auto largeIt{m_LargeTris.begin()};
+
+    while (binIt != binEnd || largeIt != m_LargeTris.end()) {
+      std::uint32_t triSetupIndex;
+
+      if (largeIt == m_LargeTris.end() || (binIt != binEnd && *binIt < *largeIt)) {
+        triSetupIndex = *binIt++;
+      }
+      else {
+        triSetupIndex = *largeIt++;
+      }
+
+      const TriSetup& triSetup{m_TriSetups[triSetupIndex]};
+
+      if (triSetup.xMax < tileX || triSetup.xMin > tileXMax || triSetup.yMax < tileY || triSetup.yMin > tileYMax) {
+        continue;
+      }
+
+      const int xMin{std::max(triSetup.xMin, tileX)};
+      const int xMax{std::min(triSetup.xMax, tileXMax)};
+      const int yMin{std::max(triSetup.yMin, tileY)};
+      const int yMax{std::min(triSetup.yMax, tileYMax)};
+
+      // The smallest triangles are cheaper to traverse than to test
+      if constexpr (g_UseHiZ) {
+        if ((xMax - xMin + 1) * (yMax - yMin + 1) >= k_HiZMinTestArea && IsOccluded(triSetup, xMin, xMax, yMin, yMax)) {
+          continue;
+        }
+      }
+
+      TraverseTri(triSetup, xMin, xMax, yMin, yMax);
+
+      if constexpr (g_UseHiZ) {
+        for (int blockRow{yMin / k_HiZBlockSize}; blockRow <= yMax / k_HiZBlockSize; ++blockRow) {
+          for (int blockCol{xMin / k_HiZBlockSize}; blockCol <= xMax / k_HiZBlockSize; ++blockCol) {
+            m_HiZDirty[static_cast<std::size_t>(blockRow * m_HiZCols + blockCol)] = 1;
+          }
+        }
+      }
     }
   }
 
-  bool Rasterization::IsPointInsideTri(const Vector2& point, const Vertex& v1, const Vertex& v2, const Vertex& v3) const {
-    // Contains the vertices of the triangle mapped on the screen
-    std::array<Vector2, 3> verts {
-      Vector2{v1.position.x, v1.position.y},
-      Vector2{v2.position.x, v2.position.y},
-      Vector2{v3.position.x, v3.position.y}
-    };
+  // The edge functions and the depth are evaluated once at the beginning of
+  // each row, then the span kernel steps them along it
+  void Rasterization::TraverseTri(const TriSetup& triSetup, int xMin, int xMax, int yMin, int yMax) {
+    const auto& edges{triSetup.edges};
+    const float xStart{static_cast<float>(xMin)};
+    const std::size_t width{static_cast<std::size_t>(m_Screen.GetWidth())};
 
-    // Contains the edges of the triangle
-    std::array<Vector2, 3> edges {
-      Vector2{verts[1] - verts[0]},
-      Vector2{verts[2] - verts[1]},
-      Vector2{verts[0] - verts[2]}
-    };
+    SpanSetup spanSetup{};
+    spanSetup.w0Dx = edges[0].a;
+    spanSetup.w1Dx = edges[1].a;
+    spanSetup.w2Dx = edges[2].a;
+    spanSetup.zDx = triSetup.zDx;
+
+    for (int y{yMax}; y >= yMin; --y) {
+      const float yRow{static_cast<float>(y)};
 
-    // The <= operator is used because the vertices are ordered clock-wise
-    return Math::CrossProduct(edges[0], point - verts[0]).z <= 0.0f &&
-      Math::CrossProduct(edges[1], point - verts[1]).z <= 0.0f &&
-      Math::CrossProduct(edges[2], point - verts[2]).z <= 0.0f;
+      spanSetup.w0 = edges[0].a * xStart + edges[0].b * yRow + edges[0].c;
+      spanSetup.w1 = edges[1].a * xStart + edges[1].b * yRow + edges[1].c;
+      spanSetup.w2 = edges[2].a * xStart + edges[2].b * yRow + edges[2].c;
+      spanSetup.z = triSetup.zDx * xStart + triSetup.zDy * yRow + triSetup.zC;
+
+      // The clamped bounding box guarantees that the span lies inside the screen
+      float* zRow{m_ZBuffer.data() + static_cast<std::size_t>(y) * width + static_cast<std::size_t>(xMin)};
+      char* pixelRow{m_Screen.GetScreenRow(y) + xMin};
+
+      m_SpanKernel(spanSetup, xMax - xMin + 1, zRow, pixelRow, triSetup.pixelChar);
+    }
   }
 
-  // This function uses the plane's equation (ax + by + cz + d = 0) to calculate
-  // the z-value of a point inside a triangle
-  float Rasterization::CalculateZValue(const Vertex& v1, const Vertex& v2, const Vertex& v3, const Vector2& point) const {
-    std::array<Vector3, 2> edges {
-      Vector3{v2.position - v1.position},
-      Vector3{v3.position - v1.position}
+  // The depth is linear over the rectangle, so its smallest value there is
+  // at one of the corners. Inside the triangle it is never lower than the
+  // one of its vertices either, so the larger of the two bounds is used. The
+  // span kernel steps the depth instead of evaluating the plane, hence the
+  // margin. Since a pixel is only written when its depth is strictly lower,
+  // a triangle that does not go below the largest depth of every block it
+  // overlaps would not change any of them
+  bool Rasterization::IsOccluded(const TriSetup& triSetup, int xMin, int xMax, int yMin, int yMax) {
+    const float x0{static_cast<float>(xMin)}, x1{static_cast<float>(xMax)};
+    const float y0{static_cast<float>(yMin)}, y1{static_cast<float>(yMax)};
+
+    const float rectZMin{
+      std::min(triSetup.zDx * x0, triSetup.zDx * x1) + std::min(triSetup.zDy * y0, triSetup.zDy * y1) + triSetup.zC
     };
+    const float zMin{std::max(rectZMin, triSetup.zMin)};
 
-    // The vector's components represents the coefficients of the plane's equation (x = a, y = b, z = c)
-    Vector3 triNormal{Math::CrossProduct(edges[0], edges[1])};
+    const float margin{k_HiZDepthEpsilon * (
+      std::abs(zMin) + std::abs(triSetup.zC) + (std::abs(triSetup.zDx) + std::abs(triSetup.zDy)) * static_cast<float>(k_TileSize)
+    )};
+    const float zTest{zMin - margin};
 
-    if (triNormal.z == 0.0f) {
-      return std::numeric_limits<float>::infinity();
+    for (int blockRow{yMin / k_HiZBlockSize}; blockRow <= yMax / k_HiZBlockSize; ++blockRow) {
+      for (int blockCol{xMin / k_HiZBlockSize}; blockCol <= xMax / k_HiZBlockSize; ++blockCol) {
+        if (!(zTest >= GetHiZ(blockCol, blockRow))) {
+          return false;
+        }
+      }
     }
-    else {
-      float d{-Math::DotProduct(triNormal, v1.position)};
 
-      return -(triNormal.x * point.x + triNormal.y * point.y + d) / triNormal.z;
+    return true;
+  }
+
+  // Recomputes the largest depth of the block if it was drawn since the last time
+  float Rasterization::GetHiZ(int blockCol, int blockRow) {
+    const std::size_t blockIndex{static_cast<std::size_t>(blockRow * m_HiZCols + blockCol)};
+
+    if (m_HiZDirty[blockIndex]) {
+      const int xStart{blockCol * k_HiZBlockSize};
+      const int xEnd{std::min(xStart + k_HiZBlockSize, m_Screen.GetWidth())};
+      const int yStart{blockRow * k_HiZBlockSize};
+      const int yEnd{std::min(yStart + k_HiZBlockSize, m_Screen.GetHeight())};
+      const std::size_t width{static_cast<std::size_t>(m_Screen.GetWidth())};
+
+      float zMax{-std::numeric_limits<float>::infinity()};
+
+      if (xEnd - xStart == k_HiZBlockSize) {
+        // One maximum per lane, which the compiler turns into vector instructions
+        std::array<float, k_HiZBlockSize> laneMax;
+        laneMax.fill(-std::numeric_limits<float>::infinity());
+
+        for (int y{yStart}; y < yEnd; ++y) {
+          const float* zRow{m_ZBuffer.data() + static_cast<std::size_t>(y) * width + static_cast<std::size_t>(xStart)};
+
+          for (std::size_t i{0}; i < laneMax.size(); ++i) {
+            laneMax[i] = std::max(laneMax[i], zRow[i]);
+          }
+        }
+
+        zMax = *std::max_element(laneMax.begin(), laneMax.end());
+      }
+      else {
+        for (int y{yStart}; y < yEnd; ++y) {
+          const float* zRow{m_ZBuffer.data() + static_cast<std::size_t>(y) * width};
+
+          for (int x{xStart}; x < xEnd; ++x) {
+            zMax = std::max(zMax, zRow[x]);
+          }
+        }
+      }
+
+      m_HiZ[blockIndex] = zMax;
+      m_HiZDirty[blockIndex] = 0;
     }
+
+    return m_HiZ[blockIndex];
+  }
+
+  char Rasterization::GetPixelChar(float triBrightness) const {
+    std::size_t index = static_cast<std::size_t>(triBrightness * static_cast<float>((m_PixelChars.size() - 1)));
+    index = std::min(index, m_PixelChars.size() - 1);
+
+    return m_PixelChars[index];
   }
   
 }
@@ -3,34 +3,98 @@
 
 #include "entity/component/mesh/mesh.h"
 #include "geometry/primitive.h"
+#include "rasterization/pixel_kernel.h"
 #include "screen/screen.h"
+#include "thread_pool/thread_pool.h"
 
 #include <array>
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 
+// The screen is split into square tiles. Every triangle is first assigned
+// to the tiles its bounding box overlaps (binning), then the tiles are
+// rasterized independently by the thread pool. Triangles overlapping at most
+// k_MaxBinnedTiles tiles are sorted into per-tile ranges of a single array
+// (counting sort), the larger ones go to a shared list that every tile
+// checks. Both have a size bounded by the number of triangles, so their
+// capacity is reserved once per mesh and the binning never allocates.
+// Since each tile only touches its own region of the z-buffer and of the
+// screen, and receives the triangles in the same order as the index buffer,
+// the output does not depend on the number of threads.
+// Alongside the z-buffer, a coarse depth buffer keeps the largest depth of
+// each block of k_HiZBlockSize x k_HiZBlockSize pixels. A triangle whose
+// smallest depth is not lower than the largest one of every block it
+// overlaps cannot pass the depth test anywhere, so it is rejected before
+// its traversal. The blocks touched by a traversal are only flagged, and
+// their depth is recomputed when a later test needs it
+
 namespace engine {
 
+  // Coefficients of the edge function E(x, y) = a * x + b * y + c. A point
+  // lies on the inner side of the edge when E(x, y) <= 0
+  struct EdgeFunction {
+    float a, b, c;
+  };
+
+  // Everything needed to traverse a triangle, computed once per triangle.
+  // Moving one pixel along x adds a to each edge function and zDx to the
+  // depth, moving along y adds b and zDy
+  struct TriSetup {
+    std::array<EdgeFunction, 3> edges;
+    float zDx, zDy, zC;   // Plane of the triangle: z = zDx * x + zDy * y + zC
+    float zMin;           // Smallest depth of the vertices
+    int xMin, xMax;       // Bounding box, clamped to the screen
+    int yMin, yMax;
+    char pixelChar;
+  };
+
   class Rasterization {
   public:
-    Rasterization(Screen& screen);
+    // threadCount includes the calling thread; 0 means one per hardware thread
+    Rasterization(Screen& screen, std::size_t threadCount = 0);
+
+    // Setter (the best kernel supported by the CPU is chosen by default)
+    void SetSpanKernelType(SpanKernelType spanKernelType);
+
+    // Getter
+    SpanKernelType GetSpanKernelType() const;
 
     void RasterizeMesh(const Mesh& mesh);
 
   private:
+    static constexpr int k_TileSize{32};
+    static constexpr int k_MaxBinnedTiles{4};
+    static constexpr int k_HiZBlockSize{8};           // Divides k_TileSize, so no block is shared by two tiles
+    static constexpr int k_HiZMinTestArea{16};        // Pixels of the bounding box below which no test is done
+    static constexpr float k_HiZDepthEpsilon{1e-5f};  // Relative margin for the rounding of the stepped depth
+    static_assert(k_TileSize % k_HiZBlockSize == 0);
+
     Screen& m_Screen;
-    int m_XMin, m_XMax;
-    int m_YMin, m_YMax;
     const std::array<char, 10> m_PixelChars;
     std::vector<float> m_ZBuffer;
 
-    void SetupTriBorders(const Vertex& v1, const Vertex& v2, const Vertex& v3);
-    void TraverseTri(const Vertex& v1, const Vertex& v2, const Vertex& v3, float triBrightness);
-        
-    void HandlePixelShading(int x, int y, float triBrightness, float zValue);
-    void HandleMerging(int x, int y, char pixelChar, float zValue);
+    SpanKernelType m_SpanKernelType;
+    SpanKernel m_SpanKernel;            // Coverage and depth test of a row of pixels
+    ThreadPool m_ThreadPool;
+    int m_TileCols, m_TileRows;
+    std::vector<TriSetup> m_TriSetups;          // Triangles that survived the setup
+    std::vector<std::uint32_t> m_TileOffsets;   // Range of each tile inside m_TileBins
+    std::vector<std::uint32_t> m_TileBins;      // Indices into m_TriSetups, grouped by tile
+    std::vector<std::uint32_t> m_LargeTris;     // Indices into m_TriSetups of the large triangles
+    int m_HiZCols, m_HiZRows;
+    std::vector<float> m_HiZ;                   // Largest depth of each block
+    std::vector<std::uint8_t> m_HiZDirty;       // Blocks drawn since their depth was computed
 
-    bool IsPointInsideTri(const Vector2& point, const Vertex& v1, const Vertex& v2, const Vertex& v3) const;
-    float CalculateZValue(const Vertex& v1, const Vertex& v2, const Vertex& v3, const Vector2& point) const;
+    bool SetupTriBorders(const Vector3& p1, const Vector3& p2, const Vector3& p3, TriSetup& triSetup) const;
+    bool SetupTri(const Vector3& p1, const Vector3& p2, const Vector3& p3, float triBrightness, TriSetup& triSetup) const;
+    void BinTris();
+    void RasterizeTile(std::size_t tileIndex);
+    void TraverseTri(const TriSetup& triSetup, int xMin, int xMax, int yMin, int yMax);
+    bool IsOccluded(const TriSetup& triSetup, int xMin, int xMax, int yMin, int yMax);
+    float GetHiZ(int blockCol, int blockRow);
+        
+    char GetPixelChar(float triBrightness) const;
   };
   
 }
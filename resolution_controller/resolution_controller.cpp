@@ -0,0 +1,73 @@
+#include "resolution_controller.h"
+
+#include "settings.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace engine {
+
+  ResolutionController::ResolutionController() :
+    m_FrameTimeBudget{0.0f},
+    m_Scale{1.0f},
+    m_AverageRenderTime{0.0f},
+    m_FrameCount{0}
+  {}
+
+  void ResolutionController::SetFrameTimeBudget(float frameTimeBudget) {
+    if (!(frameTimeBudget >= 0.0f)) {
+      throw std::invalid_argument("EXCEPTION: the frame time budget must be greater than or equal to 0");
+    }
+
+    m_FrameTimeBudget = frameTimeBudget;
+  }
+
+  float ResolutionController::GetFrameTimeBudget() const { return m_FrameTimeBudget; }
+
+  float ResolutionController::GetScale() const { return m_Scale; }
+
+  bool ResolutionController::Update(float renderTime, Screen& screen) {
+    if (m_FrameTimeBudget <= 0.0f) {
+      if (m_Scale == 1.0f) {
+        return false;
+      }
+
+      ApplyScale(1.0f, screen);
+      return true;
+    }
+
+    // The frames rendered right after a change are not representative yet
+    m_AverageRenderTime = m_FrameCount == 0 ? renderTime : m_AverageRenderTime + k_Smoothing * (renderTime - m_AverageRenderTime);
+
+    if (++m_FrameCount < k_SettleFrames) {
+      return false;
+    }
+
+    // The pixel count grows with the square of the scale
+    float scale{m_Scale * std::sqrt(k_BudgetUsage * m_FrameTimeBudget / std::max(m_AverageRenderTime, 1e-6f))};
+    scale = std::clamp(scale, g_MinResolutionScale, std::min(1.0f, m_Scale * k_MaxScaleUp));
+
+    // The full resolution is restored even by a small change
+    bool isSmallChange{std::abs(scale - m_Scale) < k_Hysteresis * m_Scale};
+
+    if (scale == m_Scale || (isSmallChange && scale < 1.0f)) {
+      return false;
+    }
+
+    ApplyScale(scale, screen);
+    return true;
+  }
+
+  void ResolutionController::ApplyScale(float scale, Screen& screen) {
+    const int width{std::max(1, static_cast<int>(std::lround(scale * static_cast<float>(screen.GetOutputWidth()))))};
+    const int height{std::max(1, static_cast<int>(std::lround(scale * static_cast<float>(screen.GetOutputHeight()))))};
+
+    screen.SetWidth(width);
+    screen.SetHeight(height);
+
+    m_Scale = scale;
+    m_FrameCount = 0;
+  }
+
+}
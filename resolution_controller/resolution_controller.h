@@ -0,0 +1,49 @@
+#ifndef RESOLUTION_CONTROLLER_H
+#define RESOLUTION_CONTROLLER_H
+
+#include "screen/screen.h"
+
+#include <cstddef>
+
+// Keeps the render time of the frames within a budget by scaling the render
+// resolution of the screen (both axes by the same factor, down to
+// g_MinResolutionScale of the output resolution). The render time is
+// assumed to be proportional to the pixel count: the controller averages it
+// over a few frames, estimates the scale that would use k_BudgetUsage of the
+// budget and applies it when it differs enough from the current one. Since
+// the screen and the z-buffer keep their capacity, a change never allocates
+
+namespace engine {
+
+  class ResolutionController {
+  public:
+    ResolutionController();
+
+    // Setter (in seconds, 0 = no budget, i.e. full resolution)
+    void SetFrameTimeBudget(float frameTimeBudget);
+
+    // Getters
+    float GetFrameTimeBudget() const;
+    float GetScale() const;
+
+    // Returns true when the render resolution of the screen has been changed
+    bool Update(float renderTime, Screen& screen);
+
+  private:
+    static constexpr float k_BudgetUsage{0.8f};       // Leaves room for the frame time variance
+    static constexpr float k_Smoothing{0.2f};         // Weight of the last frame in the average
+    static constexpr float k_Hysteresis{0.05f};       // Relative scale change below which nothing is done
+    static constexpr float k_MaxScaleUp{1.1f};        // Per change, so that the scale grows back gently
+    static constexpr std::size_t k_SettleFrames{8};   // Frames averaged after each change
+
+    float m_FrameTimeBudget;
+    float m_Scale;
+    float m_AverageRenderTime;
+    std::size_t m_FrameCount;     // Since the last change
+
+    void ApplyScale(float scale, Screen& screen);
+  };
+
+}
+
+#endif
@@ -0,0 +1,192 @@
+#include "bvh.h"
+
+#include <algorithm>
+
+namespace engine {
+
+  void Bvh::Update(std::vector<Object3D>& objects) {
+    if (objects.size() != m_ObjectLeaves.size()) {
+      Build(objects);
+      return;
+    }
+
+    for (std::size_t i{0}; i < objects.size(); ++i) {
+      Transform& transform{objects[i].GetTransform()};
+
+      if (transform.IsModelMatrixDirty()) {
+        m_ObjectBounds[i] = CalculateWorldBounds(objects[i]);
+        transform.ClearModelMatrixDirty();
+
+        Refit(i);
+      }
+    }
+  }
+
+  void Bvh::CullFrustum(const Frustum& frustum, std::vector<std::size_t>& objectIndices) const {
+    if (m_Nodes.empty()) {
+      return;
+    }
+
+    m_Stack.clear();
+    m_Stack.push_back(0);
+
+    while (!m_Stack.empty()) {
+      const Node& node{m_Nodes[m_Stack.back()]};
+      m_Stack.pop_back();
+
+      if (frustum.IsOutside(node.bounds)) {
+        continue;
+      }
+
+      // Leaves are added as they are, as their box has just been tested
+      if (node.left == k_NoNode || frustum.Contains(node.bounds)) {
+        objectIndices.insert(objectIndices.end(), m_ObjectOrder.begin() + node.first, m_ObjectOrder.begin() + node.first + node.count);
+        continue;
+      }
+
+      m_Stack.push_back(node.right);
+      m_Stack.push_back(node.left);
+    }
+  }
+
+  void Bvh::QueryRay(const Vector3& origin, const Vector3& direction, float maxDistance, std::vector<std::size_t>& objectIndices) const {
+    if (m_Nodes.empty()) {
+      return;
+    }
+
+    // Division by zero gives infinity, which the slab test handles
+    const Vector3 inverseDirection{1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z};
+
+    m_Stack.clear();
+    m_Stack.push_back(0);
+
+    while (!m_Stack.empty()) {
+      const Node& node{m_Nodes[m_Stack.back()]};
+      m_Stack.pop_back();
+
+      float distance;
+      if (!node.bounds.IntersectsRay(origin, inverseDirection, maxDistance, distance)) {
+        continue;
+      }
+
+      if (node.left == k_NoNode) {
+        objectIndices.push_back(m_ObjectOrder[node.first]);
+        continue;
+      }
+
+      m_Stack.push_back(node.right);
+      m_Stack.push_back(node.left);
+    }
+  }
+
+  std::size_t Bvh::GetNodeCount() const { return m_Nodes.size(); }
+
+  const Aabb& Bvh::GetObjectBounds(std::size_t objectIndex) const { return m_ObjectBounds[objectIndex]; }
+
+  // Both the transformed box and the box of the transformed sphere enclose
+  // the object, so their intersection does too, and is often much tighter
+  // than either of them
+  Aabb Bvh::CalculateWorldBounds(const Object3D& object3D) {
+    const Mesh& mesh{object3D.GetMesh()};
+    const Matrix4x4& modelMat{object3D.GetTransform().GetModelMatrix()};
+
+    return Aabb::GetIntersection(mesh.aabb.GetTransformed(modelMat), mesh.boundingSphere.GetTransformed(modelMat).GetAabb());
+  }
+
+  void Bvh::Build(std::vector<Object3D>& objects) {
+    m_Nodes.clear();
+    m_ObjectOrder.resize(objects.size());
+    m_ObjectLeaves.resize(objects.size());
+    m_ObjectBounds.resize(objects.size());
+
+    for (std::size_t i{0}; i < objects.size(); ++i) {
+      m_ObjectOrder[i] = i;
+      m_ObjectBounds[i] = CalculateWorldBounds(objects[i]);
+      objects[i].GetTransform().ClearModelMatrixDirty();
+    }
+
+    if (objects.empty()) {
+      return;
+    }
+
+    // A binary tree with n leaves has 2n - 1 nodes
+    m_Nodes.reserve(2 * objects.size() - 1);
+    m_Stack.reserve(2 * objects.size());
+
+    BuildNode(0, objects.size(), k_NoNode);
+  }
+
+  std::size_t Bvh::BuildNode(std::size_t first, std::size_t count, std::size_t parent) {
+    const std::size_t nodeIndex{m_Nodes.size()};
+
+    Node node;
+    node.parent = parent;
+    node.first = first;
+    node.count = count;
+    node.bounds = m_ObjectBounds[m_ObjectOrder[first]];
+
+    for (std::size_t i{first + 1}; i < first + count; ++i) {
+      node.bounds = Aabb::GetUnion(node.bounds, m_ObjectBounds[m_ObjectOrder[i]]);
+    }
+
+    m_Nodes.push_back(node);
+
+    if (count == 1) {
+      m_ObjectLeaves[m_ObjectOrder[first]] = nodeIndex;
+      return nodeIndex;
+    }
+
+    // Longest axis of the box enclosing the centers
+    Vector3 centerMin{m_ObjectBounds[m_ObjectOrder[first]].GetCenter()};
+    Vector3 centerMax{centerMin};
+
+    for (std::size_t i{first + 1}; i < first + count; ++i) {
+      const Vector3 center{m_ObjectBounds[m_ObjectOrder[i]].GetCenter()};
+      centerMin = Vector3{std::min(centerMin.x, center.x), std::min(centerMin.y, center.y), std::min(centerMin.z, center.z)};
+      centerMax = Vector3{std::max(centerMax.x, center.x), std::max(centerMax.y, center.y), std::max(centerMax.z, center.z)};
+    }
+
+    const Vector3 extents{centerMax - centerMin};
+
+    auto getAxisValue = [](const Vector3& vec, int axis) {
+      return axis == 0 ? vec.x : (axis == 1 ? vec.y : vec.z);
+    };
+
+    const int axis{extents.x >= extents.y && extents.x >= extents.z ? 0 : (extents.y >= extents.z ? 1 : 2)};
+
+    const std::size_t half{count / 2};
+    std::nth_element(
+      m_ObjectOrder.begin() + first, m_ObjectOrder.begin() + first + half, m_ObjectOrder.begin() + first + count,
+      [&](std::size_t a, std::size_t b) {
+        return getAxisValue(m_ObjectBounds[a].GetCenter(), axis) < getAxisValue(m_ObjectBounds[b].GetCenter(), axis);
+      }
+    );
+
+    // m_Nodes may be reallocated by the recursion, so the node is accessed by index
+    const std::size_t left{BuildNode(first, half, nodeIndex)};
+    const std::size_t right{BuildNode(first + half, count - half, nodeIndex)};
+
+    m_Nodes[nodeIndex].left = left;
+    m_Nodes[nodeIndex].right = right;
+
+    return nodeIndex;
+  }
+
+  // Walks up from the leaf, stopping as soon as a box does not change
+  void Bvh::Refit(std::size_t objectIndex) {
+    std::size_t nodeIndex{m_ObjectLeaves[objectIndex]};
+    m_Nodes[nodeIndex].bounds = m_ObjectBounds[objectIndex];
+
+    for (nodeIndex = m_Nodes[nodeIndex].parent; nodeIndex != k_NoNode; nodeIndex = m_Nodes[nodeIndex].parent) {
+      Node& node{m_Nodes[nodeIndex]};
+      const Aabb bounds{Aabb::GetUnion(m_Nodes[node.left].bounds, m_Nodes[node.right].bounds)};
+
+      if (bounds == node.bounds) {
+        break;
+      }
+
+      node.bounds = bounds;
+    }
+  }
+
+}
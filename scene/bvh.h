@@ -0,0 +1,64 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include "entity/object3d/object3d.h"
+#include "geometry/bounding_volume.h"
+#include "geometry/frustum.h"
+#include "geometry/primitive.h"
+
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+// Bounding volume hierarchy over the world space boxes of the objects of a
+// scene. The tree is built top-down, splitting the objects at the median of
+// their centers along the longest axis, so its depth is about log2(n).
+// When a Transform changes, only the box of its leaf and the boxes of the
+// ancestors that actually grow or shrink are updated (refit), so the tree is
+// rebuilt only when objects are added or removed. The nodes are stored in
+// depth-first order and each one refers to a contiguous range of
+// m_ObjectOrder: a node fully inside the frustum gives all of its objects
+// without visiting its children, so culling costs about what is visible
+
+namespace engine {
+
+  class Bvh {
+  public:
+    // Rebuilds the tree when the number of objects changed, otherwise refits
+    // the leaves of the objects whose model matrix changed (clearing the flag)
+    void Update(std::vector<Object3D>& objects);
+
+    // Append the indices of the objects, in no particular order
+    void CullFrustum(const Frustum& frustum, std::vector<std::size_t>& objectIndices) const;
+    void QueryRay(const Vector3& origin, const Vector3& direction, float maxDistance, std::vector<std::size_t>& objectIndices) const;
+
+    // Getters
+    std::size_t GetNodeCount() const;
+    const Aabb& GetObjectBounds(std::size_t objectIndex) const;
+
+  private:
+    static constexpr std::size_t k_NoNode{std::numeric_limits<std::size_t>::max()};
+
+    struct Node {
+      Aabb bounds;
+      std::size_t left{k_NoNode}, right{k_NoNode};    // No children for leaves
+      std::size_t parent{k_NoNode};
+      std::size_t first{0}, count{0};                 // Range of m_ObjectOrder
+    };
+
+    std::vector<Node> m_Nodes;                    // The root is the first node
+    std::vector<std::size_t> m_ObjectOrder;       // Object indices, grouped by subtree
+    std::vector<std::size_t> m_ObjectLeaves;      // Leaf node of each object
+    std::vector<Aabb> m_ObjectBounds;             // World space box of each object
+    mutable std::vector<std::size_t> m_Stack;     // Traversal stack, reused by the queries
+
+    static Aabb CalculateWorldBounds(const Object3D& object3D);
+
+    void Build(std::vector<Object3D>& objects);
+    std::size_t BuildNode(std::size_t first, std::size_t count, std::size_t parent);
+    void Refit(std::size_t objectIndex);
+  };
+
+}
+
+#endif
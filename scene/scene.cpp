@@ -1,11 +1,15 @@
 #include "scene.h"
 
+#include <utility>
+
 namespace engine {
 
-  Scene::Scene(const Object3D& object3D, const Camera& camera, const DirectionalLight& directionalLight) : 
-    object3D{object3D}, 
+  Scene::Scene(std::vector<Object3D> objects, const Camera& camera, const DirectionalLight& directionalLight) : 
+    objects{std::move(objects)}, 
     camera{camera}, 
     directionalLight{directionalLight} 
-  {}
+  {
+    bvh.Update(this->objects);
+  }
   
 }
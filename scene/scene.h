@@ -4,14 +4,18 @@
 #include "entity/camera/camera.h"
 #include "entity/light/directional_light.h"
 #include "entity/object3d/object3d.h"
+#include "scene/bvh.h"
+
+#include <vector>
 
 namespace engine {
 
   class Scene {
   public:
-    Scene(const Object3D& object3D, const Camera& camera, const DirectionalLight& directionalLight);
+    Scene(std::vector<Object3D> objects, const Camera& camera, const DirectionalLight& directionalLight);
 
-    Object3D object3D;
+    std::vector<Object3D> objects;
+    Bvh bvh;                          // Over the objects, updated by the geometry processing
     Camera camera;
     DirectionalLight directionalLight;
   };
@@ -1,21 +1,25 @@
 #include "screen.h"
 
-#include <iostream>
+#include <algorithm>
 #include <stdexcept>
 #include <string>
 
 namespace engine {
     
-  Screen::Screen(int width, int height) {
+  Screen::Screen(int width, int height) : m_OverlayLineCount{0} {
     if (width <= 0 || height <= 0) {
       throw std::invalid_argument("EXCEPTION: screen width and height must be greater than 0");
     }
 
     m_Width = width;
     m_Height = height;
+    m_OutputWidth = width;
+    m_OutputHeight = height;
     m_ScreenMat.resize(static_cast<std::size_t>(m_Width * m_Height), ' ');
   }
 
+  // The buffer keeps its capacity, so going back to a resolution that was
+  // already used does not allocate
   void Screen::SetWidth(int width) {
     if (width <= 0) {
       throw std::invalid_argument("EXCEPTION: screen width must be greater than 0");
@@ -39,11 +43,53 @@ namespace engine {
     m_ScreenMat[row * m_Width + col] = val;
   }
 
+  // The overlay is kept apart from the pixels, so it does not affect the checksum.
+  // Only the printed part of each line is stored, in strings that are kept
+  // (with the capacity of a whole row) when the overlay is cleared, so that
+  // toggling it does not allocate after the first time
+  void Screen::SetOverlayLines(const std::vector<std::string>& overlayLines) {
+    std::size_t rowWidth{2 * static_cast<std::size_t>(m_OutputWidth)};
+
+    if (m_OverlayLines.size() < overlayLines.size()) {
+      m_OverlayLines.resize(overlayLines.size());
+    }
+
+    for (std::size_t i{0}; i < overlayLines.size(); ++i) {
+      m_OverlayLines[i].reserve(rowWidth);
+      m_OverlayLines[i].assign(overlayLines[i], 0, rowWidth);
+    }
+
+    m_OverlayLineCount = overlayLines.size();
+  }
+
   int Screen::GetWidth() const { return m_Width; }
 
   int Screen::GetHeight() const { return m_Height; }
 
-  float Screen::GetAspectRatio() const { return static_cast<float>(m_Width) / m_Height; }
+  int Screen::GetOutputWidth() const { return m_OutputWidth; }
+
+  int Screen::GetOutputHeight() const { return m_OutputHeight; }
+
+  float Screen::GetAspectRatio() const { return static_cast<float>(m_OutputWidth) / m_OutputHeight; }
+
+  // REMEMBER: in order to keep this function safe, IsPixelValid() must be performed already
+  char* Screen::GetScreenRow(int row) { return m_ScreenMat.data() + row * m_Width; }
+
+  // Returns a 64-bit FNV-1a hash of the screen buffer. Two identical
+  // frames always produce the same value, so it can be used to compare runs
+  std::uint64_t Screen::GetChecksum() const {
+    constexpr std::uint64_t kFnvOffsetBasis{14695981039346656037ull};
+    constexpr std::uint64_t kFnvPrime{1099511628211ull};
+
+    std::uint64_t hash{kFnvOffsetBasis};
+
+    for (char c : m_ScreenMat) {
+      hash ^= static_cast<unsigned char>(c);
+      hash *= kFnvPrime;
+    }
+
+    return hash;
+  }
 
   // Returns a value that indicates whether a pixel is inside the screen or not
   bool Screen::IsPixelValid(int row, int col) const {
@@ -54,24 +100,43 @@ namespace engine {
     std::fill(m_ScreenMat.begin(), m_ScreenMat.end(), ' ');
   }
 
-  void Screen::PrintScreen() const {
-    std::string output;
-    output.reserve((2 * m_Width + 1) * m_Height + 10);  // Adds some chars for escape and margin
-    output.append("\033[H\033[2J");                     // Clears the terminal
+  void Screen::ClearOverlayLines() {
+    m_OverlayLineCount = 0;
+  }
 
+  // Each output pixel takes the value of the rendered pixel it falls into
+  // (nearest neighbor), which is a plain copy at full resolution
+  void Screen::ComposeFrame(std::vector<char>& frame) const {
     std::size_t w = static_cast<std::size_t>(m_Width);
     std::size_t h = static_cast<std::size_t>(m_Height);
+    std::size_t outputW = static_cast<std::size_t>(m_OutputWidth);
+    std::size_t outputH = static_cast<std::size_t>(m_OutputHeight);
+    std::size_t rowStride{2 * outputW + 1};
+
+    frame.resize(rowStride * outputH);     // Only grows when the resolution changes
 
-    for (std::size_t i{0}; i < h; ++i) {
-      for (std::size_t j{0}; j < w; ++j) {
-        char c = m_ScreenMat[i * w + j];
-        output.push_back(c);
-        output.push_back(c);
+    for (std::size_t i{0}; i < outputH; ++i) {
+      char* row{frame.data() + i * rowStride};
+      row[2 * outputW] = '\n';
+
+      // Overlay lines replace the row they are printed on, padded to its printed width
+      if (i < m_OverlayLineCount) {
+        const std::string& line{m_OverlayLines[i]};
+        std::size_t lineLength{std::min(line.size(), 2 * outputW)};
+
+        std::copy_n(line.data(), lineLength, row);
+        std::fill(row + lineLength, row + 2 * outputW, ' ');
+        continue;
       }
-      output.push_back('\n');
-    }
 
-    std::cout << output;
+      const char* pixelRow{m_ScreenMat.data() + (i * h / outputH) * w};
+
+      for (std::size_t j{0}; j < outputW; ++j) {
+        char c = w == outputW ? pixelRow[j] : pixelRow[j * w / outputW];
+        row[2 * j] = c;
+        row[2 * j + 1] = c;
+      }
+    }
   }
   
 }
@@ -1,31 +1,50 @@
 #ifndef SCREEN_H
 #define SCREEN_H
 
+#include <cstdint>
+#include <string>
 #include <vector>
 
+// The pixels are rendered at the resolution given by the width and the
+// height, which can be lowered at runtime (see ResolutionController), while
+// the frame printed on the terminal always has the output resolution given
+// at construction: ComposeFrame() stretches the pixels to it
+
 namespace engine {
 
   class Screen {
   public:
     Screen(int width, int height);
 
-    // Setters
+    // Setters (of the render resolution)
     void SetWidth(int width);
     void SetHeight(int height);
     void SetScreenPixel(int row, int col, char val);
+    void SetOverlayLines(const std::vector<std::string>& overlayLines);
 
     // Getters
     int GetWidth() const;
     int GetHeight() const;
-    float GetAspectRatio() const;
+    int GetOutputWidth() const;
+    int GetOutputHeight() const;
+    float GetAspectRatio() const;     // Of the output, as the rendered image is stretched to it
+    char* GetScreenRow(int row);
+    std::uint64_t GetChecksum() const;
         
     bool IsPixelValid(int x, int y) const;
     void ClearScreen();
-    void PrintScreen() const;
+    void ClearOverlayLines();
+
+    // Writes the characters as they appear on the terminal (doubled pixels
+    // and overlay), one row of 2 * output width characters plus '\n' at a time
+    void ComposeFrame(std::vector<char>& frame) const;
 
   private:
     int m_Width, m_Height;
+    int m_OutputWidth, m_OutputHeight;
     std::vector<char> m_ScreenMat;
+    std::vector<std::string> m_OverlayLines;  // Text printed over the first rows (not doubled)
+    std::size_t m_OverlayLineCount;
   };
   
 }
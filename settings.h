@@ -13,10 +13,36 @@ namespace engine {
   // Screen settings
   constexpr size_t g_HorizontalRes{200}; // The actual horizontal pixel count is doubled
   constexpr size_t g_VerticalRes{200};
+  constexpr bool g_UseDifferentialOutput{true};     // Prints only the characters that changed since the previous frame
+  constexpr bool g_DropStaleFrames{false};          // Replaces the frames not printed yet instead of waiting for them
 
-  // Frame rate limit settings (NOT APPLIED YET)
-  constexpr float g_FrameRateLimit{60.0f};
-  constexpr float g_TargetFrameTime{1.0f / g_FrameRateLimit};
+  // Parser settings
+  constexpr bool g_UseMeshCache{true};              // Loads the meshes from (and writes) their binary cache
+  constexpr std::size_t g_ParserThreads{0};         // Calling thread included, 0 = one per hardware thread
+  constexpr bool g_OptimizeVertexCache{true};       // Reorders the triangles and the vertices of the parsed meshes for locality
+
+  // Geometry settings
+  constexpr bool g_UseVertexStreams{true};          // Stores the vertices in the SoA layout too (SIMD vertex processing)
+  constexpr bool g_UseMeshlets{true};               // Groups the triangles into clusters culled as a whole
+
+  // Level of detail settings
+  constexpr bool g_UseLods{true};                   // Builds a chain of simplified meshes and draws the coarsest acceptable one
+  constexpr std::size_t g_LodMaxLevelCount{5};      // Full-detail level included
+  constexpr std::size_t g_LodMinTriCount{64};       // No level is simplified below it
+  constexpr float g_LodPixelError{0.5f};            // Largest screen space error (pixels) of the selected level
+
+  // Rasterization settings
+  constexpr float g_GuardBand{1024.0f};             // Pixels beyond each side of the screen where the triangles are not clipped
+  constexpr std::size_t g_RasterizationThreads{0};  // Calling thread included, 0 = one per hardware thread
+  constexpr bool g_UseHiZ{true};                    // Rejects the triangles hidden behind the depth already drawn
+
+  // Dynamic resolution settings (the budget is the frame time of the frame rate limit)
+  constexpr bool g_UseDynamicResolution{true};      // Lowers the render resolution when the frames exceed the budget
+  constexpr float g_MinResolutionScale{0.5f};       // Smallest render resolution, relative to the output resolution
+
+  // Frame rate limit settings
+  constexpr float g_FrameRateLimit{60.0f};          // Initial limit (can be changed at runtime), 0 = unlimited
+  constexpr float g_FrameSpinTime{0.001f};          // Seconds before each deadline spent spinning instead of sleeping
   
 }
 
@@ -0,0 +1,113 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+namespace engine {
+
+  ThreadPool::ThreadPool(std::size_t threadCount) : 
+    m_Task{nullptr}, 
+    m_TaskCount{0}, 
+    m_NextTask{0}, 
+    m_ActiveWorkers{0}, 
+    m_Generation{0}, 
+    m_IsStopping{false}
+  {
+    if (threadCount == 0) {
+      threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    m_Workers.reserve(threadCount - 1);
+
+    for (std::size_t i{1}; i < threadCount; ++i) {
+      m_Workers.emplace_back(&ThreadPool::WorkerLoop, this);
+    }
+  }
+
+  ThreadPool::~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock{m_Mutex};
+      m_IsStopping = true;
+    }
+
+    m_WorkCondition.notify_all();
+
+    for (auto& worker : m_Workers) {
+      worker.join();
+    }
+  }
+
+  std::size_t ThreadPool::GetThreadCount() const { return m_Workers.size() + 1; }
+
+  void ThreadPool::ParallelFor(std::size_t taskCount, const std::function<void(std::size_t)>& task) {
+    // Not worth waking the workers up
+    if (m_Workers.empty() || taskCount <= 1) {
+      for (std::size_t i{0}; i < taskCount; ++i) {
+        task(i);
+      }
+
+      return;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock{m_Mutex};
+      m_Task = &task;
+      m_TaskCount = taskCount;
+      m_NextTask = 0;
+      m_ActiveWorkers = m_Workers.size();
+      m_Exception = nullptr;
+      ++m_Generation;
+    }
+
+    m_WorkCondition.notify_all();
+
+    RunTasks();
+
+    std::unique_lock<std::mutex> lock{m_Mutex};
+    m_DoneCondition.wait(lock, [this]() { return m_ActiveWorkers == 0; });
+    m_Task = nullptr;
+
+    if (m_Exception) {
+      std::rethrow_exception(m_Exception);
+    }
+  }
+
+  void ThreadPool::WorkerLoop() {
+    std::size_t lastGeneration{0};
+
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock{m_Mutex};
+        m_WorkCondition.wait(lock, [&]() { return m_IsStopping || m_Generation != lastGeneration; });
+
+        if (m_IsStopping) {
+          return;
+        }
+
+        lastGeneration = m_Generation;
+      }
+
+      RunTasks();
+
+      std::lock_guard<std::mutex> lock{m_Mutex};
+      if (--m_ActiveWorkers == 0) {
+        m_DoneCondition.notify_one();
+      }
+    }
+  }
+
+  // Takes task indices until there are none left
+  void ThreadPool::RunTasks() {
+    for (std::size_t i{m_NextTask++}; i < m_TaskCount; i = m_NextTask++) {
+      try {
+        (*m_Task)(i);
+      }
+      catch (...) {
+        std::lock_guard<std::mutex> lock{m_Mutex};
+        if (!m_Exception) {
+          m_Exception = std::current_exception();
+        }
+      }
+    }
+  }
+  
+}
@@ -0,0 +1,55 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A minimal fork-join pool. ParallelFor() hands out task indices to the
+// worker threads and to the calling thread, and returns once every task
+// has been executed. The threads are created once and reused
+
+namespace engine {
+
+  class ThreadPool {
+  public:
+    // threadCount includes the calling thread; 0 means one per hardware thread
+    explicit ThreadPool(std::size_t threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Getter
+    std::size_t GetThreadCount() const;
+
+    // Runs task(i) for every i in [0, taskCount). The first exception thrown
+    // by a task is rethrown on the calling thread
+    void ParallelFor(std::size_t taskCount, const std::function<void(std::size_t)>& task);
+
+  private:
+    std::vector<std::thread> m_Workers;
+    std::mutex m_Mutex;
+    std::condition_variable m_WorkCondition;
+    std::condition_variable m_DoneCondition;
+
+    const std::function<void(std::size_t)>* m_Task;
+    std::size_t m_TaskCount;
+    std::atomic<std::size_t> m_NextTask;
+    std::size_t m_ActiveWorkers;
+    std::size_t m_Generation;     // Incremented at each ParallelFor() to wake the workers up
+    bool m_IsStopping;
+    std::exception_ptr m_Exception;
+
+    void WorkerLoop();
+    void RunTasks();
+  };
+  
+}
+
+#endif
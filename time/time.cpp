@@ -2,12 +2,20 @@
 
 #include "settings.h"
 
+#include <stdexcept>
+#include <thread>
+
 namespace engine {
 
   std::chrono::high_resolution_clock::time_point Time::s_LastFrameTime;
   std::chrono::high_resolution_clock::time_point Time::s_PreviousFrameTime;
   std::chrono::duration<float> Time::s_DeltaTime;
 
+  float Time::s_FrameRateLimit{0.0f};
+  Time::PacingClock::duration Time::s_FramePeriod{0};
+  Time::PacingClock::time_point Time::s_NextFrameDeadline;
+  std::size_t Time::s_MissedDeadlineCount{0};
+
   float Time::GetDeltaTime() {
     return s_DeltaTime.count();
   }
@@ -18,6 +26,36 @@ namespace engine {
     return std::chrono::duration<float>(now - s_LastFrameTime).count();
   }
 
+  std::chrono::high_resolution_clock::time_point Time::GetTimestamp() {
+    return std::chrono::high_resolution_clock::now();
+  }
+
+  float Time::GetFrameRateLimit() {
+    return s_FrameRateLimit;
+  }
+
+  std::size_t Time::GetMissedDeadlineCount() {
+    return s_MissedDeadlineCount;
+  }
+
+  void Time::SetDeltaTime(float deltaTime) {
+    s_DeltaTime = std::chrono::duration<float>(deltaTime);
+  }
+
+  // The deadlines restart from the next wait, so that a change of the limit
+  // is not counted as a missed deadline
+  void Time::SetFrameRateLimit(float frameRateLimit) {
+    if (!(frameRateLimit >= 0.0f)) {
+      throw std::invalid_argument("EXCEPTION: the frame rate limit must be greater than or equal to 0");
+    }
+
+    s_FrameRateLimit = frameRateLimit;
+    s_FramePeriod = frameRateLimit > 0.0f 
+      ? std::chrono::duration_cast<PacingClock::duration>(std::chrono::duration<double>(1.0 / frameRateLimit))
+      : PacingClock::duration{0};
+    s_NextFrameDeadline = PacingClock::time_point{};
+  }
+
   void Time::UpdateDeltaTime() {
     auto now = std::chrono::high_resolution_clock::now();
 
@@ -25,7 +63,7 @@ namespace engine {
       s_LastFrameTime = now;
       s_PreviousFrameTime = now;  
 
-      s_DeltaTime = std::chrono::duration<float>(g_TargetFrameTime);
+      s_DeltaTime = std::chrono::duration<float>(s_FramePeriod);
     }
     else {
       s_PreviousFrameTime = s_LastFrameTime;
@@ -34,5 +72,41 @@ namespace engine {
       s_DeltaTime = std::chrono::duration<float>(s_LastFrameTime - s_PreviousFrameTime);
     }
   }
+
+  // The thread sleeps until shortly before the deadline, as the wake-up of
+  // a sleep can be late by a scheduler time slice, and then spins for the
+  // rest. The deadlines advance by exactly one period, so the average frame
+  // rate does not drift; a frame that misses its deadline restarts them 
+  // from now instead of making the next frames run back to back
+  void Time::WaitForNextFrame() {
+    if (s_FramePeriod == PacingClock::duration{0}) {
+      return;
+    }
+
+    PacingClock::time_point now{PacingClock::now()};
+
+    if (s_NextFrameDeadline == PacingClock::time_point{}) {
+      s_NextFrameDeadline = now + s_FramePeriod;
+      return;
+    }
+
+    if (now > s_NextFrameDeadline) {
+      ++s_MissedDeadlineCount;
+      s_NextFrameDeadline = now + s_FramePeriod;
+      return;
+    }
+
+    const auto spinTime{std::chrono::duration_cast<PacingClock::duration>(std::chrono::duration<float>(g_FrameSpinTime))};
+
+    if (s_NextFrameDeadline - now > spinTime) {
+      std::this_thread::sleep_until(s_NextFrameDeadline - spinTime);
+    }
+
+    while (PacingClock::now() < s_NextFrameDeadline) {
+      std::this_thread::yield();
+    }
+
+    s_NextFrameDeadline += s_FramePeriod;
+  }
   
 }
@@ -2,6 +2,7 @@
 #define TIME_H
 
 #include <chrono>
+#include <cstddef>
 
 namespace engine {
 
@@ -12,12 +13,27 @@ namespace engine {
     // Getters
     static float GetDeltaTime();
     static float GetTimeSinceLastFrame();
+    static std::chrono::high_resolution_clock::time_point GetTimestamp();
+    static float GetFrameRateLimit();
+    static std::size_t GetMissedDeadlineCount();   // Frames completed after their deadline
+
+    // Setters
+    static void SetDeltaTime(float deltaTime);      // Used to simulate a fixed frame time, e.g. in headless mode
+    static void SetFrameRateLimit(float frameRateLimit);   // 0 = unlimited
 
     static void UpdateDeltaTime();
+    static void WaitForNextFrame();                 // Paces the frames according to the frame rate limit
 
   private:
+    using PacingClock = std::chrono::steady_clock;
+
     static std::chrono::high_resolution_clock::time_point s_LastFrameTime, s_PreviousFrameTime;
     static std::chrono::duration<float> s_DeltaTime;
+
+    static float s_FrameRateLimit;
+    static PacingClock::duration s_FramePeriod;
+    static PacingClock::time_point s_NextFrameDeadline;   // Default-constructed until the first wait
+    static std::size_t s_MissedDeadlineCount;
   };
   
 }